@@ -0,0 +1,242 @@
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "mrbind.hpp"
+
+DEFINE_int32(iterations, 1000000, "number of iterations for each benchmark");
+DEFINE_string(filter, "", "run only benchmarks whose name contains this string");
+
+namespace {
+template<typename F>
+void run(const std::string &name, F f) {
+  if (name.find(FLAGS_filter) == std::string::npos) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  f(FLAGS_iterations);
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  std::printf("%-48s %10.1f ns/op\n", name.c_str(), static_cast<double>(elapsed) / FLAGS_iterations);
+}
+
+// Rubyで n 回ループする式
+std::string ruby_loop(int n, const std::string &body) {
+  std::stringstream ss;
+  ss << "i = 0\n"
+     << "while i < " << n << "\n"
+     << "  " << body << "\n"
+     << "  i += 1\n"
+     << "end\n";
+  return ss.str();
+}
+
+class Counter {
+  int count_;
+
+  public:
+    Counter()
+      : count_(0) {
+    }
+
+    struct MrbMethod {
+      static int incr(Counter *self, int d) {
+        return self->count_ += d;
+      }
+
+      static int decr(Counter *self, int d) {
+        return self->count_ -= d;
+      }
+
+      static int add(Counter *self, int a, int b) {
+        return self->count_ += a + b;
+      }
+
+      static int get(Counter *self) {
+        return self->count_;
+      }
+
+      static void reset(Counter *self) {
+        self->count_ = 0;
+      }
+    };
+
+    static mrb_value raw_incr(mrb_state *state, mrb_value self) {
+      auto counter = static_cast<Counter *>(DATA_PTR(self));
+      mrb_int d;
+      mrb_get_args(state, "i", &d);
+      return mrb_fixnum_value(counter->count_ += d);
+    }
+};
+
+// C++の例外を変換するバインドと, 変換しない素のcfuncの比較
+void bench_exception_translation() {
+  mrbind::MRuby mruby;
+  auto counter_class = mruby.install_class<Counter>("Counter");
+  counter_class.define().initialize<>();
+  counter_class.define().method<int, int>().from<&Counter::MrbMethod::incr>("incr");
+  mrb_define_method(mruby.state(), mrbind::MRClass<Counter>::rclass, "raw_incr",
+      Counter::raw_incr, ARGS_REQ(1));
+  mruby.load_string("$counter = Counter.new");
+
+  run("bound method (exception translation)", [&](int n) {
+        mruby.load_string(ruby_loop(n, "$counter.incr(1)"));
+      });
+  run("bound method (raw cfunc)", [&](int n) {
+        mruby.load_string(ruby_loop(n, "$counter.raw_incr(1)"));
+      });
+
+  mruby.load_string(
+    "def id(x)\n"
+    "  x\n"
+    "end\n");
+  auto id = mruby.get_function<int(int)>("id");
+  run("MRFunction::operator()", [&](int n) {
+        for (int i = 0; i < n; i++) {
+          id(i);
+        }
+      });
+  run("MRFunction::call_checked", [&](int n) {
+        for (int i = 0; i < n; i++) {
+          id.call_checked(i);
+        }
+      });
+  run("MRFunction::try_call", [&](int n) {
+        for (int i = 0; i < n; i++) {
+          id.try_call(i);
+        }
+      });
+  run("mrb_funcall", [&](int n) {
+        auto state = mruby.state();
+        for (int i = 0; i < n; i++) {
+          mrb_funcall(state, mrb_top_self(state), "id", 1, mrb_fixnum_value(i));
+        }
+      });
+}
+
+// MRFunction::bind() による手続きの直接呼び出しと mrb_funcall の比較
+void bench_bound_function() {
+  mrbind::MRuby mruby;
+  mruby.load_string(
+    "def add(a, b)\n"
+    "  a + b\n"
+    "end\n");
+  auto add = mruby.get_function<int(int, int)>("add");
+  auto bound = add.bind();
+
+  run("mrb_funcall (add)", [&](int n) {
+        auto state = mruby.state();
+        for (int i = 0; i < n; i++) {
+          mrb_funcall(state, mrb_top_self(state), "add", 2, mrb_fixnum_value(i), mrb_fixnum_value(1));
+        }
+      });
+  run("MRFunction::operator() (add)", [&](int n) {
+        for (int i = 0; i < n; i++) {
+          add(i, 1);
+        }
+      });
+  run("MRBoundFunction::operator() (add)", [&](int n) {
+        for (int i = 0; i < n; i++) {
+          bound(i, 1);
+        }
+      });
+}
+
+constexpr mrbind::MRMethodEntry counter_methods[] = {
+  mrbind::MRClass<Counter>::initializer<>(),
+  MRBIND_METHOD("incr", Counter::MrbMethod::incr),
+  MRBIND_METHOD("decr", Counter::MrbMethod::decr),
+  MRBIND_METHOD("add", Counter::MrbMethod::add),
+  MRBIND_METHOD("get", Counter::MrbMethod::get),
+  MRBIND_METHOD("reset", Counter::MrbMethod::reset),
+};
+
+// 新しい mrb_state ごとに install(state) の時間だけを計測する
+template<typename F>
+void run_per_state(const std::string &name, F install) {
+  if (name.find(FLAGS_filter) == std::string::npos) {
+    return;
+  }
+  int n = std::max(1, FLAGS_iterations / 1000);
+  std::chrono::nanoseconds elapsed(0);
+  for (int i = 0; i < n; i++) {
+    mrbind::MRuby mruby;
+    auto start = std::chrono::steady_clock::now();
+    install(mruby);
+    elapsed += std::chrono::steady_clock::now() - start;
+  }
+  std::printf("%-48s %10.1f ns/state\n", name.c_str(), static_cast<double>(elapsed.count()) / n);
+}
+
+// define() による逐次定義と, バインド表による一括定義の比較
+void bench_class_install() {
+  run_per_state("install_class + define()", [](mrbind::MRuby &mruby) {
+        auto counter_class = mruby.install_class<Counter>("Counter");
+        counter_class.define().initialize<>();
+        counter_class.define().method<int, int>().from<&Counter::MrbMethod::incr>("incr");
+        counter_class.define().method<int, int>().from<&Counter::MrbMethod::decr>("decr");
+        counter_class.define().method<int, int, int>().from<&Counter::MrbMethod::add>("add");
+        counter_class.define().method<int>().from<&Counter::MrbMethod::get>("get");
+        counter_class.define().method<void>().from<&Counter::MrbMethod::reset>("reset");
+      });
+  run_per_state("install_class (method table)", [](mrbind::MRuby &mruby) {
+        mruby.install_class<Counter>("Counter", counter_methods);
+      });
+}
+
+// リクエストごとに新しい MRuby を作る場合と MRPool から借りる場合の比較
+void bench_pool() {
+  const std::string prelude =
+    "def score(c, n)\n"
+    "  n.times { c.incr(1) }\n"
+    "  c.get\n"
+    "end\n";
+  const std::string request =
+    "$counter = Counter.new\n"
+    "def handler; score($counter, 10); end\n"
+    "handler\n";
+  auto initialize = [&](mrbind::MRuby &mruby) {
+    mruby.install_class<Counter>("Counter", counter_methods);
+    mruby.load_string(prelude);
+  };
+
+  auto report = [](const std::string &name, int n, std::chrono::steady_clock::duration elapsed) {
+    auto sec = std::chrono::duration_cast<std::chrono::duration<double> >(elapsed).count();
+    std::printf("%-48s %10.0f req/s\n", name.c_str(), n / sec);
+  };
+  int n = std::max(1, FLAGS_iterations / 100);
+
+  if (std::string("fresh MRuby per request").find(FLAGS_filter) != std::string::npos) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+      mrbind::MRuby mruby;
+      initialize(mruby);
+      mruby.load_string(request);
+    }
+    report("fresh MRuby per request", n, std::chrono::steady_clock::now() - start);
+  }
+  if (std::string("MRPool checkout/return").find(FLAGS_filter) != std::string::npos) {
+    mrbind::MRPool pool(1, initialize);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+      auto mruby = pool.checkout();
+      mruby->load_string(request);
+    }
+    report("MRPool checkout/return", n, std::chrono::steady_clock::now() - start);
+  }
+}
+}  // anonymous namespace
+
+int main(int argc, char *argv[]) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  bench_exception_translation();
+  bench_bound_function();
+  bench_class_install();
+  bench_pool();
+  return 0;
+}
@@ -1,14 +1,33 @@
 #ifndef INCLUDE_MRBIND_HPP__
 #define INCLUDE_MRBIND_HPP__
+#include "mrbind/MRState.hpp"
+#include "mrbind/MRError.hpp"
 #include "mrbind/MRType.hpp"
+#include "mrbind/MRSymbol.hpp"
+#include "mrbind/MRHash.hpp"
+#include "mrbind/MRStruct.hpp"
+#include "mrbind/MROverloads.hpp"
 #include "mrbind/MRClass.hpp"
 #include "mrbind/MRFunction.hpp"
+#include "mrbind/MRBlock.hpp"
+#include "mrbind/MRRange.hpp"
+#include "mrbind/MRTable.hpp"
+#include "mrbind/MRProc.hpp"
+#include "mrbind/MRAsync.hpp"
+#include "mrbind/MRScriptSet.hpp"
+#include "mrbind/MRStreamLoader.hpp"
+#include "mrbind/MRGC.hpp"
+#include "mrbind/MRMarshal.hpp"
 #include "mrbind/MRuby.hpp"
+#include "mrbind/MRPool.hpp"
 #include "mrbind/MRClassDefineHelper.hpp"
 
 #include "mrbind/MRType-inl.hpp"
 #include "mrbind/MRClass-inl.hpp"
+#include "mrbind/MRRange-inl.hpp"
+#include "mrbind/MRProc-inl.hpp"
 #include "mrbind/MRuby-inl.hpp"
+#include "mrbind/MRExtern.hpp"
 
 #endif  // INCLUDE_MRBIND_HPP__
 
@@ -0,0 +1,315 @@
+#ifndef INCLUDE_MRBIND_MR_ASYNC_HPP__
+#define INCLUDE_MRBIND_MR_ASYNC_HPP__
+#include <mruby.h>
+#include <mruby/compile.h>
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * 完了待ちの処理. MRAsync が保持し, MRScheduler がポーリングする.
+ */
+struct MRPending {
+  virtual ~MRPending() {}
+  virtual bool ready() = 0;
+  virtual void wait() = 0;
+  virtual void wait_for(std::chrono::milliseconds timeout) = 0;
+  virtual mrb_value value(mrb_state *state) = 0;
+};
+
+/*!
+ * バインドしたメソッドの非同期の戻り値. std::future または std::shared_future から生成する.
+ *
+ * MRuby::spawn で実行中のFiberから呼ばれた場合はFiberを中断し, 結果が揃った時点で
+ * MRScheduler が結果を戻り値としてFiberを再開する. 失敗した場合は呼び出し元で例外を発生させる.
+ * それ以外から呼ばれた場合は完了を待って結果を返す.
+ */
+template<typename T>
+class MRAsync {
+  template<typename Future>
+  struct FuturePending : MRPending {
+    Future future;
+
+    explicit FuturePending(Future &&f)
+      : future(std::move(f)) {
+    }
+
+    bool ready() {
+      return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void wait() {
+      future.wait();
+    }
+
+    void wait_for(std::chrono::milliseconds timeout) {
+      future.wait_for(timeout);
+    }
+
+    mrb_value value(mrb_state *state) {
+      return MRType<T>::to_mrb_value(state, future.get());
+    }
+  };
+
+  std::shared_ptr<MRPending> pending_;
+
+  public:
+    MRAsync(std::future<T> &&f)
+      : pending_(std::make_shared<FuturePending<std::future<T> > >(std::move(f))) {
+    }
+
+    MRAsync(std::shared_future<T> f)
+      : pending_(std::make_shared<FuturePending<std::shared_future<T> > >(std::move(f))) {
+    }
+
+    const std::shared_ptr<MRPending> &pending() const {
+      return pending_;
+    }
+};
+
+template<typename R>
+struct MRIsAsync : std::false_type {
+};
+
+template<typename T>
+struct MRIsAsync<MRAsync<T> > : std::true_type {
+};
+
+/*!
+ * mrb_stateごとのFiberの実行管理. MRStateData に保持する.
+ *
+ * spawn したFiberを順に再開し, MRAsync の完了を待っているFiberは完了後に再開する.
+ * 待っていた処理がC++の例外で失敗した場合, MRExceptions で変換した例外を中断した位置で発生させる.
+ *
+ * cfunc の中からは再開後に例外を発生させられないため, MRAsync を返すメソッドは本体を
+ * 別名 (impl_name()) で定義し, 同名のRubyのメソッドから呼び出す. Fiber.yield と例外の発生は
+ * Ruby側 (MRAsync.result) で行う.
+ */
+class MRScheduler {
+  public:
+    typedef std::function<void(const MRExpected<mrb_value> &)> Callback;
+
+  private:
+    struct Task {
+      mrb_value fiber;
+      std::shared_ptr<MRPending> pending;
+      Callback on_done;
+      std::list<Task>::iterator position;
+    };
+
+    std::list<Task> tasks_;
+    std::vector<Task *> ready_;
+    std::vector<Task *> waiting_;
+    Task *current_;
+
+    // 中断を表す値. Ruby側の MRAsync::PENDING
+    mrb_value pending_marker_;
+
+  public:
+    MRScheduler()
+      : current_(nullptr), pending_marker_(mrb_nil_value()) {
+    }
+
+    void spawn(mrb_state *state, mrb_value proc, Callback on_done);
+
+    /*!
+     * MRAsync を返すメソッドの本体を impl_name(name) で定義した後に呼び出し,
+     * name に中断と例外の処理を行うRubyのメソッドを定義する.
+     */
+    void define_async(mrb_state *state, RClass *rclass, const std::string &name);
+
+    /*!
+     * MRAsync を返す cfunc の Proc を, 中断と例外の処理を行うRubyの Proc で包む.
+     */
+    mrb_value wrap_async(mrb_state *state, mrb_value proc);
+
+    static std::string impl_name(const std::string &name) {
+      return "__mrbind_async_" + name + "__";
+    }
+
+    /*!
+     * 実行可能なFiberと完了した待ちのFiberを1度ずつ再開し, 残りのFiber数を返す.
+     */
+    std::size_t run_once(mrb_state *state);
+
+    void run(mrb_state *state);
+
+    mrb_value await(mrb_state *state, const std::shared_ptr<MRPending> &pending);
+
+    std::size_t size() const {
+      return tasks_.size();
+    }
+
+    /*!
+     * 未完了のタスクを全て破棄する. on_done には RuntimeError を渡す. MRuby::reset() から使う.
+     */
+    void cancel_all(mrb_state *state);
+
+  private:
+    RClass *prepare(mrb_state *state);
+    void resume(mrb_state *state, Task *task, int argc, const mrb_value *argv);
+    void finish(mrb_state *state, Task *task, const MRExpected<mrb_value> &result);
+};
+
+inline void MRScheduler::spawn(mrb_state *state, mrb_value proc, Callback on_done) {
+  auto fiber_class = mrb_obj_value(mrb_class_get(state, "Fiber"));
+  auto fiber = mrb_funcall_with_block(state, fiber_class, mrb_intern_lit(state, "new"), 0, nullptr, proc);
+  mrb_gc_register(state, fiber);
+
+  auto it = tasks_.insert(tasks_.end(), Task({ fiber, nullptr, on_done, std::list<Task>::iterator() }));
+  it->position = it;
+  ready_.push_back(&*it);
+}
+
+inline RClass *MRScheduler::prepare(mrb_state *state) {
+  // MRPool の reset() で定数が消えている場合は定義し直す
+  if (mrb_class_defined(state, "MRAsync")) {
+    return mrb_class_get(state, "MRAsync");
+  }
+  if (mrb_nil_p(pending_marker_)) {
+    pending_marker_ = mrb_obj_new(state, state->object_class, 0, nullptr);
+    mrb_gc_register(state, pending_marker_);
+  }
+
+  int ai = mrb_gc_arena_save(state);
+  auto rclass = mrb_define_class(state, "MRAsync", state->object_class);
+  mrb_define_const(state, rclass, "PENDING", pending_marker_);
+  mrb_load_string(state,
+      "class MRAsync\n"
+      "  def self.result(r)\n"
+      "    return r unless PENDING.equal?(r)\n"
+      "    ok, r = Fiber.yield\n"
+      "    raise r unless ok\n"
+      "    r\n"
+      "  end\n"
+      "  def self.method_body(impl)\n"
+      "    async = self\n"
+      "    Proc.new { |*args, &block| async.result(__send__(impl, *args, &block)) }\n"
+      "  end\n"
+      "  def self.proc_body(impl)\n"
+      "    async = self\n"
+      "    Proc.new { |*args, &block| async.result(impl.call(*args, &block)) }\n"
+      "  end\n"
+      "end\n");
+  mrb_gc_arena_restore(state, ai);
+  return rclass;
+}
+
+inline void MRScheduler::define_async(mrb_state *state, RClass *rclass, const std::string &name) {
+  int ai = mrb_gc_arena_save(state);
+  auto impl = impl_name(name);
+  auto body = mrb_funcall(state, mrb_obj_value(prepare(state)), "method_body", 1,
+      mrb_symbol_value(mrb_intern(state, impl.data(), impl.size())));
+  auto sym = mrb_symbol_value(mrb_intern(state, name.data(), name.size()));
+  mrb_funcall_with_block(state, mrb_obj_value(rclass), mrb_intern_lit(state, "define_method"), 1, &sym, body);
+  mrb_gc_arena_restore(state, ai);
+}
+
+inline mrb_value MRScheduler::wrap_async(mrb_state *state, mrb_value proc) {
+  return mrb_funcall(state, mrb_obj_value(prepare(state)), "proc_body", 1, proc);
+}
+
+inline std::size_t MRScheduler::run_once(mrb_state *state) {
+  std::vector<Task *> ready;
+  ready.swap(ready_);
+  for (auto task : ready) {
+    auto nil = mrb_nil_value();
+    resume(state, task, 1, &nil);
+  }
+
+  std::vector<Task *> waiting;
+  waiting.swap(waiting_);
+  for (auto task : waiting) {
+    if (!task->pending->ready()) {
+      waiting_.push_back(task);
+      continue;
+    }
+
+    // MRAsync.result に [成功したか, 値または例外] を返す
+    int ai = mrb_gc_arena_save(state);
+    mrb_value argv[2] = { mrb_true_value(), mrb_nil_value() };
+    try {
+      argv[1] = task->pending->value(state);
+    } catch (...) {
+      argv[0] = mrb_false_value();
+      argv[1] = MRExceptions::current(state);
+    }
+    resume(state, task, 2, argv);
+    mrb_gc_arena_restore(state, ai);
+  }
+  return tasks_.size();
+}
+
+inline void MRScheduler::run(mrb_state *state) {
+  while (run_once(state)) {
+    if (ready_.empty() && !waiting_.empty()) {
+      waiting_.front()->pending->wait_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+inline mrb_value MRScheduler::await(mrb_state *state, const std::shared_ptr<MRPending> &pending) {
+  // spawn したFiberの外では完了を待つ
+  if (!current_ || mrb_ptr(current_->fiber) != static_cast<void *>(state->c->fib)) {
+    pending->wait();
+    return pending->value(state);
+  }
+
+  // 中断は呼び出し元の MRAsync.result が行う
+  current_->pending = pending;
+  return pending_marker_;
+}
+
+inline void MRScheduler::resume(mrb_state *state, Task *task, int argc, const mrb_value *argv) {
+  int ai = mrb_gc_arena_save(state);
+  task->pending.reset();
+  current_ = task;
+  auto result = mrb_funcall_argv(state, task->fiber, mrb_intern_lit(state, "resume"), argc, argv);
+  current_ = nullptr;
+
+  if (state->exc) {
+    finish(state, task, MRExpected<mrb_value>(MRError::take(state)));
+  } else if (task->pending) {
+    waiting_.push_back(task);
+  } else if (!mrb_test(mrb_funcall(state, task->fiber, "alive?", 0))) {
+    finish(state, task, MRExpected<mrb_value>(result));
+  } else {
+    // Fiber.yield で自発的に中断した
+    ready_.push_back(task);
+  }
+  mrb_gc_arena_restore(state, ai);
+}
+
+inline void MRScheduler::finish(mrb_state *state, Task *task, const MRExpected<mrb_value> &result) {
+  if (task->on_done) {
+    task->on_done(result);
+  }
+  mrb_gc_unregister(state, task->fiber);
+  tasks_.erase(task->position);
+}
+
+inline void MRScheduler::cancel_all(mrb_state *state) {
+  ready_.clear();
+  waiting_.clear();
+  current_ = nullptr;
+  while (!tasks_.empty()) {
+    finish(state, &tasks_.front(), MRExpected<mrb_value>(MRError("RuntimeError", "task cancelled by reset")));
+  }
+}
+
+template<typename T>
+struct MRType<MRAsync<T> > {
+  // 戻り値専用
+  static mrb_value to_mrb_value(mrb_state *state, const MRAsync<T> &v) {
+    return MRStateData::get(state)->slot<MRScheduler>().await(state, v.pending());
+  }
+};
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_ASYNC_HPP__
@@ -0,0 +1,81 @@
+#ifndef INCLUDE_MRBIND_MR_BLOCK_HPP__
+#define INCLUDE_MRBIND_MR_BLOCK_HPP__
+#include <mruby.h>
+
+#include <string>
+
+namespace mrbind {
+template<typename _Signature>
+class MRBlock;
+
+/*!
+ * バインドしたメソッドに渡されたRubyのブロック.
+ *
+ * メソッドの引数型に指定すると mrb_get_args の "&" で受け取る.
+ * 呼び出しごとに mrb_yield_argv でブロックを実行する. 引数はスタック上の配列に
+ * 変換するためヒープ確保は発生せず, GC arenaは呼び出しの前後で元に戻す.
+ * そのため戻り値が mrb_value や文字列ポインタの場合, その寿命は呼び出し側で管理すること.
+ * ブロックが渡されていない場合の呼び出しは LocalJumpError となる. 省略可能にする場合は is_given() で確認すること.
+ */
+template<typename R, typename ... Args>
+class MRBlock<R(Args ...)> {
+  mrb_state *mrb_;
+  mrb_value block_;
+
+  public:
+    typedef R result_type;
+
+    MRBlock(mrb_state *mrb, mrb_value block)
+      : mrb_(mrb), block_(block) {
+    }
+
+    bool is_given() const {
+      return !mrb_nil_p(block_);
+    }
+
+    mrb_value value() const {
+      return block_;
+    }
+
+    result_type operator()(Args ... args) const {
+      if (!is_given()) {
+        throw MRError("LocalJumpError", "no block given");
+      }
+      // 戻り値の変換が終わってからアリーナを戻す
+      ArenaScope scope(mrb_);
+      mrb_value argv[sizeof ... (Args) + 1] = {
+        MRType<Args>::to_mrb_value(mrb_, args) ..., mrb_nil_value()
+      };
+      auto result = mrb_yield_argv(mrb_, block_, sizeof ... (Args), argv);
+      return MRType<result_type>::to_c_value(mrb_, result);
+    }
+
+  private:
+    struct ArenaScope {
+      mrb_state *mrb;
+      int ai;
+
+      explicit ArenaScope(mrb_state *m)
+        : mrb(m), ai(mrb_gc_arena_save(m)) {
+      }
+
+      ~ArenaScope() {
+        mrb_gc_arena_restore(mrb, ai);
+      }
+    };
+};
+
+template<typename R, typename ... Args>
+struct MRType<MRBlock<R(Args ...)> > {
+  typedef mrb_value argument_type;
+
+  static MRBlock<R(Args ...)> expand_argument(mrb_state *state, argument_type arg) {
+    return MRBlock<R(Args ...)>(state, arg);
+  }
+
+  static std::string arg_char() {
+    return "&";
+  }
+};
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_BLOCK_HPP__
@@ -1,18 +1,135 @@
 #ifndef INCLUDE_MRBIND_MR_CLASS_INL_HPP__
 #define INCLUDE_MRBIND_MR_CLASS_INL_HPP__
+#include <mruby/array.h>
+
+#include <iterator>
+#include <mutex>
+#include <new>
 #include <string>
 
 namespace mrbind {
 template<typename T>
 MRClass<T> MRClass<T>::create(mrb_state *state, const std::string &name, RClass *super) {
+  return MRClass<T>(state, define_class(state, name.c_str(), super));
+}
+
+template<typename T>
+template<std::size_t N>
+MRClass<T> MRClass<T>::install(mrb_state *state, const char *name,
+    const MRMethodEntry (&methods)[N], RClass *super) {
+  auto c = define_class(state, name, super);
+  for (const auto &m : methods) {
+    if (m.async) {
+      std::string method_name(m.name, m.length);
+      mrb_define_method(state, c, MRScheduler::impl_name(method_name).c_str(), m.func, m.aspec);
+      MRStateData::get(state)->slot<MRScheduler>().define_async(state, c, method_name);
+    } else {
+      mrb_define_method_id(state, c, mrb_intern_static(state, m.name, m.length), m.func, m.aspec);
+    }
+  }
+  return MRClass<T>(state, c);
+}
+
+template<typename T>
+RClass *MRClass<T>::get_class(mrb_state *state) {
+  return MRStateData::get(state)->slot<StateClass>().rclass;
+}
+
+template<typename T>
+RClass *MRClass<T>::define_class(mrb_state *state, const char *name, RClass *super) {
   if (!super) {
     super = state->object_class;
   }
-  rclass = mrb_define_class(state, name.c_str(), super);
-  MRB_SET_INSTANCE_TT(rclass, MRB_TT_DATA);
-  class_name = name;
-  data_type = { name.c_str(), free_instance };
-  return MRClass<T>(state);
+  auto c = mrb_define_class(state, name, super);
+  MRB_SET_INSTANCE_TT(c, MRB_TT_DATA);
+  auto &slot = MRStateData::get(state)->slot<StateClass>();
+  slot.rclass = c;
+  slot.name = name;
+  rclass = c;
+
+  // 複数のスレッドから別々の mrb_state に定義しても, データ型の書き込みは一度だけ
+  std::call_once(type_once, [name]() {
+        class_name = name;
+        data_type = { class_name.c_str(), free_instance };
+        batch_data_type = { class_name.c_str(), free_batched };
+        borrowed_data_type = { class_name.c_str(), free_borrowed };
+      });
+  return c;
+}
+
+template<typename T>
+const std::string &MRClass<T>::name(mrb_state *state) {
+  return MRStateData::get(state)->slot<StateClass>().name;
+}
+
+template<typename T>
+T *MRClass<T>::get_ptr(mrb_state *state, mrb_value v) {
+  if (mrb_type(v) == MRB_TT_DATA && (DATA_TYPE(v) == &batch_data_type || DATA_TYPE(v) == &borrowed_data_type)) {
+    return static_cast<T *>(DATA_PTR(v));
+  }
+  return static_cast<T *>(mrb_data_get_ptr(state, v, &data_type));
+}
+
+template<typename T>
+template<typename Iterator>
+mrb_value MRClass<T>::wrap_many(mrb_state *state, Iterator first, Iterator last) {
+  return make_many(state, std::distance(first, last), [&](void *p, std::size_t) {
+        new (p) T(*first++);
+      });
+}
+
+template<typename T>
+template<typename Init>
+mrb_value MRClass<T>::construct_many(mrb_state *state, std::size_t n, Init initialize) {
+  return make_many(state, n, [&](void *p, std::size_t i) {
+        initialize(new (p) T(), i);
+      });
+}
+
+template<typename T>
+template<typename Construct>
+mrb_value MRClass<T>::make_many(mrb_state *state, std::size_t n, Construct construct) {
+  auto ary = mrb_ary_new_capa(state, n);
+  if (n == 0) {
+    return ary;
+  }
+
+  // 全ての T を生成してからラッパーを作る
+  auto block = static_cast<char *>(::operator new(batch_offset() + sizeof(BatchSlot) * n));
+  auto header = new (block) BatchHeader();
+  auto slots = reinterpret_cast<BatchSlot *>(block + batch_offset());
+  std::size_t i = 0;
+  try {
+    for (; i < n; i++) {
+      construct(&slots[i].storage, i);
+      slots[i].header = header;
+    }
+  } catch (...) {
+    while (i--) {
+      reinterpret_cast<T *>(&slots[i].storage)->~T();
+    }
+    ::operator delete(block);
+    throw;
+  }
+  header->live = n;
+
+  int ai = mrb_gc_arena_save(state);
+  for (i = 0; i < n; i++) {
+    auto obj = mrb_data_object_alloc(state, get_class(state), &slots[i].storage, &batch_data_type);
+    mrb_ary_push(state, ary, mrb_obj_value(obj));
+    mrb_gc_arena_restore(state, ai);
+  }
+  return ary;
+}
+
+template<typename T>
+void MRClass<T>::free_batched(mrb_state *, void *ptr) {
+  auto slot = reinterpret_cast<BatchSlot *>(ptr);
+  auto header = slot->header;
+  static_cast<T *>(ptr)->~T();
+  if (--header->live == 0) {
+    ::operator delete(header);
+  }
 }
 
 template<typename T>
@@ -23,16 +140,23 @@ typename MRClass<T>::Definer MRClass<T>::define() {
 template<typename T>
 template<typename ... Args>
 void MRClass<T>::Definer::initialize() {
-  mrb_define_method(clazz->state_, MRClass<T>::rclass, "initialize",
-      [](mrb_state *state, mrb_value self) -> mrb_value {
-        // コンストラクタ引数の取得
-        auto args = MRClassDefineHelper<Args ...>::get_args(state);
+  MROverloads::define(clazz->state_, clazz->rclass_, "initialize", &MRClass<T>::template construct<Args ...>,
+      MRuby::args_format_string<Args ...>(),
+      (sizeof ... (Args)) ? ARGS_REQ(sizeof ... (Args)) : ARGS_NONE());
+}
+
+template<typename T>
+template<typename ... Args>
+mrb_value MRClass<T>::construct(mrb_state *state, mrb_value self) {
+  // コンストラクタ引数の取得
+  auto args = MRClassDefineHelper<Args ...>::get_args(state);
 
-        // RData型とインスタンスの生成
+  // RData型とインスタンスの生成
+  return MRExceptions::guard(state, [&]() {
         DATA_TYPE(self) = &MRClass<T>::data_type;
-        DATA_PTR(self) = MRClassDefineHelper<Args ...>::template new_instance<T>(args);
+        DATA_PTR(self) = MRClassDefineHelper<Args ...>::template new_instance<T>(state, args);
         return self;
-      }, (sizeof ... (Args)) ? ARGS_REQ(sizeof ... (Args)) : ARGS_NONE());
+      });
 }
 
 template<typename T>
@@ -45,16 +169,30 @@ template<typename T>
 template<typename R, typename ... Args>
 template<R Fn(T *, Args ...)>
 void MRClass<T>::MethodDefiner<R, Args ...>::from(const std::string & name) {
-  mrb_define_method(clazz->state_, MRClass<T>::rclass, name.c_str(),
-      [](mrb_state *state, mrb_value self) -> mrb_value {
-        // receiverオブジェクトとメソッド引数の取得
-        T *p = static_cast<T *>(mrb_get_datatype(state, self, &MRClass<T>::data_type));
-        auto args = MRClassDefineHelper<Args ...>::get_args(state);
-
-        // メソッドを実行
-        auto result = MRClassDefineHelper<Args ...>::template call_method<T, R, Fn>(p, args);
-        return MRType<R>::to_mrb_value(state, result);
-      }, (sizeof ... (Args)) ? ARGS_REQ(sizeof ... (Args)) : ARGS_NONE());
+  auto state = clazz->state_;
+  MROverloads::define(state, clazz->rclass_,
+      MRIsAsync<R>::value ? MRScheduler::impl_name(name) : name, &MethodDefiner::template invoke<Fn>,
+      MRuby::args_format_string<Args ...>(),
+      (sizeof ... (Args)) ? ARGS_REQ(sizeof ... (Args)) : ARGS_NONE());
+  if (MRIsAsync<R>::value) {
+    MRStateData::get(state)->slot<MRScheduler>().define_async(state, clazz->rclass_, name);
+  }
+}
+
+template<typename T>
+template<typename R, typename ... Args>
+template<R Fn(T *, Args ...)>
+mrb_value MRClass<T>::MethodDefiner<R, Args ...>::invoke(mrb_state *state, mrb_value self) {
+  // receiverオブジェクトとメソッド引数の取得
+  T *p = MRClass<T>::get_ptr(state, self);
+  auto args = MRClassDefineHelper<Args ...>::get_args(state);
+
+  // メソッドを実行
+  return MRExceptions::guard(state, [&]() {
+        return MRMethodResult<R>::invoke(state, [&]() {
+              return MRClassDefineHelper<Args ...>::template call_method<T, R, Fn>(state, p, args);
+            });
+      });
 }
 }  // namespace mrbind
 #endif  // INCLUDE_MRBIND_MR_CLASS_INL_HPP__
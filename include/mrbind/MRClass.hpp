@@ -4,25 +4,112 @@
 #include <mruby/class.h>
 #include <mruby/data.h>
 
+#include <atomic>
+#include <cstddef>
+#include <mutex>
 #include <string>
+#include <type_traits>
 
 namespace mrbind {
+/*!
+ * バインド表の1エントリ. MRClass<T>::initializer() と MRBIND_METHOD() で constexpr に生成する.
+ *
+ * 名前は静的な文字列で, length は終端のヌル文字を含まない長さ.
+ * async は戻り値が MRAsync の場合に真で, MRScheduler::define_async() で登録する.
+ */
+struct MRMethodEntry {
+  const char *name;
+  std::size_t length;
+  mrb_func_t func;
+  mrb_aspec aspec;
+  bool async;
+};
+
+template<typename R>
+struct MRIsAsync;
+
 template<typename T>
 class MRClass {
   mrb_state *state_;
+  RClass *rclass_;
 
   public:
-    static RClass *rclass;
+    // 最後に create() / install() した mrb_state のクラス. 状態ごとのクラスは get_class() で取得する
+    static std::atomic<RClass *> rclass;
+    // データ型は最初の create() / install() で一度だけ初期化し, 以後は書き換えない
     static mrb_data_type data_type;
+    static mrb_data_type batch_data_type;
+    // C++ から返したポインタのラップ. Ruby 側では解放しない
+    static mrb_data_type borrowed_data_type;
+    // データ型の名前 (最初に定義した名前). Ruby 側の名前は name() で取得する
     static std::string class_name;
 
     static MRClass create(mrb_state *state, const std::string &name, RClass *super);
 
+    /*!
+     * クラスを定義し, バインド表のメソッドを1回の走査で登録する.
+     *
+     * 名前は mrb_intern_static で登録するため, 表の定義以外にヒープ確保は発生しない.
+     * 同名のエントリは後のものが優先される (型による多重定義は define() を使う).
+     *
+     *   static constexpr mrbind::MRMethodEntry person_methods[] = {
+     *     mrbind::MRClass<Person>::initializer<char *, int>(),
+     *     MRBIND_METHOD("greeting", Person::MrbMethod::greeting),
+     *   };
+     *   mrbind::MRClass<Person>::install(state, "Person", person_methods);
+     */
+    template<std::size_t N>
+    static MRClass install(mrb_state *state, const char *name,
+        const MRMethodEntry (&methods)[N], RClass *super = nullptr);
+
+    /*!
+     * state で定義されたクラスの取得. 未定義の場合は nullptr.
+     */
+    static RClass *get_class(mrb_state *state);
+
+    /*!
+     * state で定義したクラスの名前. 未定義の場合は空文字列.
+     */
+    static const std::string &name(mrb_state *state);
+
+    // バインド表のエントリの生成
+    template<typename ... Args>
+    static constexpr MRMethodEntry initializer() {
+      return MRMethodEntry{ "initialize", 10, &MRClass<T>::template construct<Args ...>,
+          (sizeof ... (Args)) ? ARGS_REQ(sizeof ... (Args)) : ARGS_NONE(), false };
+    }
+
+    /*!
+     * インスタンスのポインタの取得. 個別に生成したもの, まとめて生成したもの, C++ から返したポインタのいずれも受け付ける.
+     */
+    static T *get_ptr(mrb_state *state, mrb_value v);
+
+    /*!
+     * T をまとめて生成し, RubyのArrayとして返す.
+     *
+     * N個の T は1つの連続した領域に確保し, 全てのラッパーが解放された時点で領域を解放する.
+     * construct_many() はデフォルトコンストラクタで生成した後に initialize(T *, index) を呼ぶ.
+     */
+    template<typename Iterator>
+    static mrb_value wrap_many(mrb_state *state, Iterator first, Iterator last);
+
+    template<typename Init>
+    static mrb_value construct_many(mrb_state *state, std::size_t n, Init initialize);
+
     template<typename R, typename ... Args>
     struct MethodDefiner {
       MRClass *clazz;
       template<R Fn(T *, Args ...)>
       void from(const std::string &name);
+
+      template<R Fn(T *, Args ...), std::size_t N>
+      static constexpr MRMethodEntry entry(const char (&name)[N]) {
+        return MRMethodEntry{ name, N - 1, &MethodDefiner::template invoke<Fn>,
+            (sizeof ... (Args)) ? ARGS_REQ(sizeof ... (Args)) : ARGS_NONE(), MRIsAsync<R>::value };
+      }
+
+      template<R Fn(T *, Args ...)>
+      static mrb_value invoke(mrb_state *state, mrb_value self);
     };
 
     struct Definer {
@@ -37,19 +124,79 @@ class MRClass {
 
     Definer define();
 
+    template<typename ... Args>
+    static mrb_value construct(mrb_state *state, mrb_value self);
+
   private:
-    explicit MRClass(mrb_state *state)
-      : state_(state) {
+    MRClass(mrb_state *state, RClass *rclass)
+      : state_(state), rclass_(rclass) {
     }
 
+    // mrb_stateごとのクラス
+    struct StateClass {
+      RClass *rclass = nullptr;
+      std::string name;
+    };
+
+    static std::once_flag type_once;
+
+    static RClass *define_class(mrb_state *state, const char *name, RClass *super);
+
     static void free_instance(mrb_state *, void *ptr) {
       delete static_cast<T *>(ptr);
     }
+
+    static void free_borrowed(mrb_state *, void *) {
+    }
+
+    // まとめて生成した領域. 先頭に BatchHeader, 続けて BatchSlot を並べる
+    struct BatchHeader {
+      std::size_t live;
+    };
+
+    struct BatchSlot {
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+      BatchHeader *header;
+    };
+
+    static std::size_t batch_offset() {
+      return (sizeof(BatchHeader) + alignof(BatchSlot) - 1) / alignof(BatchSlot) * alignof(BatchSlot);
+    }
+
+    template<typename Construct>
+    static mrb_value make_many(mrb_state *state, std::size_t n, Construct construct);
+
+    static void free_batched(mrb_state *, void *ptr);
 };
 
-template<typename T> RClass * MRClass<T>::rclass;
+/*!
+ * 関数ポインタの型から MRClass<T>::MethodDefiner を選ぶ. MRBIND_METHOD() から使用する.
+ */
+template<typename F, F Fn>
+struct MRMethodOf;
+
+template<typename T, typename R, typename ... Args, R (*Fn)(T *, Args ...)>
+struct MRMethodOf<R (*)(T *, Args ...), Fn> {
+  template<std::size_t N>
+  static constexpr MRMethodEntry entry(const char (&name)[N]) {
+    return MRClass<T>::template MethodDefiner<R, Args ...>::template entry<Fn>(name);
+  }
+};
+
+template<typename T> std::atomic<RClass *> MRClass<T>::rclass;
 template<typename T> mrb_data_type MRClass<T>::data_type;
+template<typename T> mrb_data_type MRClass<T>::batch_data_type;
+template<typename T> mrb_data_type MRClass<T>::borrowed_data_type;
 template<typename T> std::string MRClass<T>::class_name;
+template<typename T> std::once_flag MRClass<T>::type_once;
 }  // namespace mrbind
+
+/*!
+ * バインド表のメソッドエントリ. fn は T * を第1引数に取る関数.
+ *
+ *   MRBIND_METHOD("greeting", Person::MrbMethod::greeting)
+ */
+#define MRBIND_METHOD(name, fn) \
+  mrbind::MRMethodOf<decltype(&fn), &fn>::entry(name)
 #endif  // INCLUDE_MRBIND_MR_CLASS_HPP__
 
@@ -13,6 +13,26 @@ namespace mrbind {
 template<typename ... Ts>
 struct MRClassDefineHelper;
 
+/*!
+ * メソッドの戻り値の変換. void の場合は nil を返す.
+ */
+template<typename R>
+struct MRMethodResult {
+  template<typename F>
+  static mrb_value invoke(mrb_state *state, F f) {
+    return MRType<R>::to_mrb_value(state, f());
+  }
+};
+
+template<>
+struct MRMethodResult<void> {
+  template<typename F>
+  static mrb_value invoke(mrb_state *, F f) {
+    f();
+    return mrb_nil_value();
+  }
+};
+
 // 0引数
 template<>
 struct MRClassDefineHelper<> {
@@ -21,12 +41,12 @@ struct MRClassDefineHelper<> {
   }
 
   template<typename T>
-  static T *new_instance(const std::tuple<> &args) {
+  static T *new_instance(mrb_state *state, const std::tuple<> &args) {
     return new T();
   }
 
   template<typename T, typename R, R Fn(T *)>
-  static R call_method(T *first, const std::tuple<> &args) {
+  static R call_method(mrb_state *state, T *first, const std::tuple<> &args) {
     return Fn(first);
   }
 };
@@ -46,15 +66,15 @@ struct MRClassDefineHelper<Arg1> {
   }
 
   template<typename T>
-  static T *new_instance(const std::tuple<MRArg1> &args) {
+  static T *new_instance(mrb_state *state, const std::tuple<MRArg1> &args) {
     return new T(
-      MRType<Arg1>::expand_argument(std::get<0>(args)));
+      MRType<Arg1>::expand_argument(state, std::get<0>(args)));
   }
 
   template<typename T, typename R, R Fn(T *, Arg1)>
-  static R call_method(T *first, const std::tuple<MRArg1> &args) {
+  static R call_method(mrb_state *state, T *first, const std::tuple<MRArg1> &args) {
     return Fn(first,
-               MRType<Arg1>::expand_argument(std::get<0>(args)));
+               MRType<Arg1>::expand_argument(state, std::get<0>(args)));
   }
 };
 
@@ -76,17 +96,17 @@ struct MRClassDefineHelper<Arg1, Arg2> {
   }
 
   template<typename T>
-  static T *new_instance(const std::tuple<MRArg1, MRArg2> &args) {
+  static T *new_instance(mrb_state *state, const std::tuple<MRArg1, MRArg2> &args) {
     return new T(
-      MRType<Arg1>::expand_argument(std::get<0>(args)),
-      MRType<Arg2>::expand_argument(std::get<1>(args)));
+      MRType<Arg1>::expand_argument(state, std::get<0>(args)),
+      MRType<Arg2>::expand_argument(state, std::get<1>(args)));
   }
 
   template<typename T, typename R, R Fn(T *, Arg1, Arg2)>
-  static R call_method(T *first, const std::tuple<MRArg1, MRArg2> &args) {
+  static R call_method(mrb_state *state, T *first, const std::tuple<MRArg1, MRArg2> &args) {
     return Fn(first,
-               MRType<Arg1>::expand_argument(std::get<0>(args)),
-               MRType<Arg2>::expand_argument(std::get<1>(args)));
+               MRType<Arg1>::expand_argument(state, std::get<0>(args)),
+               MRType<Arg2>::expand_argument(state, std::get<1>(args)));
   }
 };
 
@@ -111,19 +131,19 @@ struct MRClassDefineHelper<Arg1, Arg2, Arg3> {
   }
 
   template<typename T>
-  static T *new_instance(const std::tuple<MRArg1, MRArg2, MRArg3> &args) {
+  static T *new_instance(mrb_state *state, const std::tuple<MRArg1, MRArg2, MRArg3> &args) {
     return new T(
-      MRType<Arg1>::expand_argument(std::get<0>(args)),
-      MRType<Arg2>::expand_argument(std::get<1>(args)),
-      MRType<Arg3>::expand_argument(std::get<2>(args)));
+      MRType<Arg1>::expand_argument(state, std::get<0>(args)),
+      MRType<Arg2>::expand_argument(state, std::get<1>(args)),
+      MRType<Arg3>::expand_argument(state, std::get<2>(args)));
   }
 
   template<typename T, typename R, R Fn(T *, Arg1, Arg2, Arg3)>
-  static R call_method(T *first, const std::tuple<MRArg1, MRArg2, MRArg3> &args) {
+  static R call_method(mrb_state *state, T *first, const std::tuple<MRArg1, MRArg2, MRArg3> &args) {
     return Fn(first,
-               MRType<Arg1>::expand_argument(std::get<0>(args)),
-               MRType<Arg2>::expand_argument(std::get<1>(args)),
-               MRType<Arg3>::expand_argument(std::get<2>(args)));
+               MRType<Arg1>::expand_argument(state, std::get<0>(args)),
+               MRType<Arg2>::expand_argument(state, std::get<1>(args)),
+               MRType<Arg3>::expand_argument(state, std::get<2>(args)));
   }
 };
 }  // namespace mrbind
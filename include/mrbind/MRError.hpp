@@ -0,0 +1,287 @@
+#ifndef INCLUDE_MRBIND_MR_ERROR_HPP__
+#define INCLUDE_MRBIND_MR_ERROR_HPP__
+#include <mruby.h>
+#include <mruby/string.h>
+#include <mruby/throw.h>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * Rubyで発生した例外. 例外クラス名とメッセージを保持する.
+ * バインドしたメソッドから送出した場合は同名のRubyの例外クラスとして再送出される.
+ */
+class MRError : public std::runtime_error {
+  std::string class_name_;
+
+  public:
+    MRError(const std::string &class_name, const std::string &message)
+      : std::runtime_error(message), class_name_(class_name) {
+    }
+
+    const std::string &class_name() const {
+      return class_name_;
+    }
+
+    /*!
+     * mrb_state::exc の例外を取り出してクリアする.
+     */
+    static MRError take(mrb_state *state);
+};
+
+/*!
+ * 戻り値またはRubyの例外のどちらかを保持する.
+ */
+template<typename R>
+class MRExpected {
+  R value_;
+  std::shared_ptr<const MRError> error_;
+
+  public:
+    MRExpected(const R &value)
+      : value_(value) {
+    }
+
+    MRExpected(const MRError &error)
+      : value_(), error_(std::make_shared<MRError>(error)) {
+    }
+
+    bool has_value() const {
+      return !error_;
+    }
+
+    explicit operator bool() const {
+      return has_value();
+    }
+
+    const R &value() const {
+      if (error_) {
+        throw *error_;
+      }
+      return value_;
+    }
+
+    R value_or(const R &other) const {
+      return error_ ? other : value_;
+    }
+
+    const MRError &error() const {
+      return *error_;
+    }
+};
+
+template<>
+class MRExpected<void> {
+  std::shared_ptr<const MRError> error_;
+
+  public:
+    MRExpected() {
+    }
+
+    MRExpected(const MRError &error)
+      : error_(std::make_shared<MRError>(error)) {
+    }
+
+    bool has_value() const {
+      return !error_;
+    }
+
+    explicit operator bool() const {
+      return has_value();
+    }
+
+    void value() const {
+      if (error_) {
+        throw *error_;
+      }
+    }
+
+    const MRError &error() const {
+      return *error_;
+    }
+};
+
+/*!
+ * C++の例外からRubyの例外への変換.
+ *
+ * バインドしたメソッドで送出されたC++の例外は catch 節の外で mrb_exc_raise し直すため,
+ * mrubyのVMをC++の例外が通過することはない. 例外が無い場合の追加コストは無い.
+ * 対応表は mrb_state ごとに MRStateData に保持し, 後から登録したものを優先する.
+ * 同じ型を再度登録した場合は置き換える. mrb_state と同様にスレッド間で共有しないこと.
+ * 未登録の std::exception は RuntimeError になる.
+ */
+class MRExceptions {
+  typedef bool (*Translator)(mrb_state *state, const char *class_name, mrb_value *exc);
+
+  struct Entry {
+    Translator translator;
+    std::string class_name;
+  };
+
+  public:
+    struct Table {
+      std::vector<Entry> entries;
+    };
+
+    template<typename E>
+    static void map(mrb_state *state, const std::string &class_name) {
+      auto &entries = MRStateData::get(state)->slot<Table>().entries;
+      entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry &e) {
+            return e.translator == &translate<E>;
+          }), entries.end());
+      entries.insert(entries.begin(), Entry({ translate<E>, class_name }));
+    }
+
+    /*!
+     * バインドしたC関数の本体 f を実行し, C++の例外をRubyの例外として送出する.
+     * mrubyをC++の例外で構築した場合, mruby自身の大域脱出はそのまま通す.
+     */
+    template<typename F>
+    static mrb_value guard(mrb_state *state, F f);
+
+    /*!
+     * catch 節の中で呼び出し, 処理中の例外に対応するRubyの例外オブジェクトを返す.
+     */
+    static mrb_value current(mrb_state *state);
+
+    static mrb_value make(mrb_state *state, const char *class_name, const char *message);
+
+    /*!
+     * 型の変換などの失敗を送出する. Rubyの実行中 (mrb_state::jmp が設定済み) はRubyの例外,
+     * ホストのコードから呼ばれた場合は脱出先が無いため MRError を送出する.
+     */
+    static void raise(mrb_state *state, const char *class_name, const std::string &message);
+
+    /*!
+     * ホストのコードから f を実行する. mrb_funcall と同様に例外の脱出先を用意し,
+     * Rubyの例外は mrb_state::exc に設定し, mrb_funcall と同じく例外オブジェクトを返す.
+     * Rubyの実行中は f をそのまま呼ぶ.
+     */
+    template<typename F>
+    static mrb_value protect(mrb_state *state, F f);
+
+  private:
+    template<typename E>
+    static bool translate(mrb_state *state, const char *class_name, mrb_value *exc) {
+      try {
+        throw;
+      } catch (const E &e) {
+        *exc = make(state, class_name, e.what());
+        return true;
+      } catch (...) {
+        return false;
+      }
+    }
+};
+
+template<typename F>
+mrb_value MRExceptions::guard(mrb_state *state, F f) {
+  mrb_value exc;
+  try {
+    return f();
+#ifdef MRB_ENABLE_CXX_EXCEPTION
+  } catch (mrb_jmpbuf_impl) {
+    throw;
+#endif
+  } catch (...) {
+    exc = current(state);
+  }
+  mrb_exc_raise(state, exc);
+  return mrb_nil_value();
+}
+
+template<typename F>
+mrb_value MRExceptions::protect(mrb_state *state, F f) {
+  if (state->jmp) {
+    return f();
+  }
+
+  // 深い再帰で cibase / stbase が再確保される場合があるため, フレームはポインタではなく位置で巻き戻す
+  mrb_value result;
+  auto nth_ci = state->c->ci - state->c->cibase;
+  struct mrb_jmpbuf c_jmp;
+  MRB_TRY(&c_jmp) {
+    state->jmp = &c_jmp;
+    result = f();
+    state->jmp = nullptr;
+  }
+  MRB_CATCH(&c_jmp) {
+    state->jmp = nullptr;
+    while (nth_ci < state->c->ci - state->c->cibase) {
+      state->c->stack = state->c->ci->stackent;
+      state->c->ci--;
+    }
+    result = mrb_obj_value(state->exc);
+  }
+  MRB_END_EXC(&c_jmp);
+  return result;
+}
+
+inline MRError MRError::take(mrb_state *state) {
+  auto exc = mrb_obj_value(state->exc);
+  state->exc = nullptr;
+
+  // exc から外した例外オブジェクトを message の呼び出し中のGCから保護する
+  int ai = mrb_gc_arena_save(state);
+  mrb_gc_protect(state, exc);
+  auto message = mrb_funcall(state, exc, "message", 0);
+  state->exc = nullptr;
+  MRError error(mrb_obj_classname(state, exc),
+      mrb_string_p(message) ? std::string(RSTRING_PTR(message), RSTRING_LEN(message)) : "");
+  mrb_gc_arena_restore(state, ai);
+  return error;
+}
+
+inline mrb_value MRExceptions::make(mrb_state *state, const char *class_name, const char *message) {
+  auto rclass = mrb_class_defined(state, class_name)
+    ? mrb_class_get(state, class_name)
+    : mrb_class_get(state, "RuntimeError");
+  return mrb_exc_new_str(state, rclass, mrb_str_new_cstr(state, message));
+}
+
+inline void MRExceptions::raise(mrb_state *state, const char *class_name, const std::string &message) {
+  if (!state->jmp) {
+    throw MRError(class_name, message);
+  }
+  mrb_exc_raise(state, make(state, class_name, message.c_str()));
+}
+
+inline mrb_value MRExceptions::current(mrb_state *state) {
+  if (state->ud) {
+    for (const auto &entry : MRStateData::get(state)->slot<Table>().entries) {
+      mrb_value exc;
+      if (entry.translator(state, entry.class_name.c_str(), &exc)) {
+        return exc;
+      }
+    }
+  }
+
+  try {
+    throw;
+  } catch (const MRError &e) {
+    return make(state, e.class_name().c_str(), e.what());
+  } catch (const std::bad_alloc &e) {
+    return make(state, "NoMemoryError", e.what());
+  } catch (const std::invalid_argument &e) {
+    return make(state, "ArgumentError", e.what());
+  } catch (const std::domain_error &e) {
+    return make(state, "ArgumentError", e.what());
+  } catch (const std::out_of_range &e) {
+    return make(state, "IndexError", e.what());
+  } catch (const std::range_error &e) {
+    return make(state, "RangeError", e.what());
+  } catch (const std::overflow_error &e) {
+    return make(state, "RangeError", e.what());
+  } catch (const std::exception &e) {
+    return make(state, "RuntimeError", e.what());
+  } catch (...) {
+    return make(state, "RuntimeError", "unknown C++ exception");
+  }
+}
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_ERROR_HPP__
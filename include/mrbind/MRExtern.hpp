@@ -0,0 +1,45 @@
+#ifndef INCLUDE_MRBIND_MR_EXTERN_HPP__
+#define INCLUDE_MRBIND_MR_EXTERN_HPP__
+
+/*!
+ * 明示的インスタンス化. MRBIND_EXPLICIT_INSTANTIATION を定義した場合のみ有効になる.
+ *
+ * バインドする型を宣言するヘッダで MRBIND_EXTERN_CLASS(T) を, いずれか1つの翻訳単位で
+ * MRBIND_INSTANTIATE_CLASS(T) を使うと, MRClass<T> と MRType<T *> の実体化が1回で済む.
+ * MRFunction のシグネチャについても同様. グローバル名前空間で使用すること.
+ *
+ *   // person.hpp
+ *   MRBIND_EXTERN_CLASS(Person)
+ *   MRBIND_EXTERN_FUNCTION(int(int, int))
+ *
+ *   // person.cc
+ *   MRBIND_INSTANTIATE_CLASS(Person)
+ *   MRBIND_INSTANTIATE_FUNCTION(int(int, int))
+ *
+ * 定義しない場合はどのマクロも何も生成しない.
+ */
+#ifdef MRBIND_EXPLICIT_INSTANTIATION
+#define MRBIND_EXTERN_CLASS(type) \
+  extern template class mrbind::MRClass<type>; \
+  extern template struct mrbind::MRType<type *>; \
+  extern template struct mrbind::MRType<const type *>;
+
+#define MRBIND_INSTANTIATE_CLASS(type) \
+  template class mrbind::MRClass<type>; \
+  template struct mrbind::MRType<type *>; \
+  template struct mrbind::MRType<const type *>;
+
+#define MRBIND_EXTERN_FUNCTION(signature) \
+  extern template class mrbind::MRFunction<signature>; \
+  extern template class mrbind::MRBoundFunction<signature>;
+
+#define MRBIND_INSTANTIATE_FUNCTION(signature) \
+  template class mrbind::MRFunction<signature>; \
+  template class mrbind::MRBoundFunction<signature>;
+#else
+#define MRBIND_EXTERN_CLASS(type)
+#define MRBIND_INSTANTIATE_CLASS(type)
+#define MRBIND_EXTERN_FUNCTION(signature)
+#define MRBIND_INSTANTIATE_FUNCTION(signature)
+#endif
+#endif  // INCLUDE_MRBIND_MR_EXTERN_HPP__
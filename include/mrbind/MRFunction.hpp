@@ -1,39 +1,191 @@
 #ifndef INCLUDE_MRBIND_MR_FUNCTION_HPP__
 #define INCLUDE_MRBIND_MR_FUNCTION_HPP__
 #include <mruby.h>
+#include <mruby/class.h>
+#include <mruby/proc.h>
+#include <mruby/throw.h>
 
+#include <memory>
 #include <string>
 #include <functional>
+#include <type_traits>
 
 namespace mrbind {
 template<typename _Signature>
 class MRFunction;
 
+template<typename _Signature>
+class MRBoundFunction;
+
 template<typename R, typename ... Args>
 class MRFunction<R(Args ...)> {
   typedef std::function<R(Args ...)> function;
   mrb_state *mrb_;
   mrb_value receiver_;
-  std::string name_;
+  mrb_sym name_;
 
   public:
     typedef R result_type;
 
     MRFunction(mrb_state *mrb, mrb_value receiver, const std::string &name)
-      : mrb_(mrb), receiver_(receiver), name_(name) {
+      : mrb_(mrb), receiver_(receiver), name_(mrb_intern(mrb, name.data(), name.size())) {
     }
 
     MRFunction(mrb_state *mrb, const std::string &name)
-      : mrb_(mrb), receiver_(mrb_top_self(mrb)), name_(name) {
+      : mrb_(mrb), receiver_(mrb_top_self(mrb)), name_(mrb_intern(mrb, name.data(), name.size())) {
+    }
+
+    MRFunction(mrb_state *mrb, mrb_value receiver, mrb_sym name)
+      : mrb_(mrb), receiver_(receiver), name_(name) {
     }
 
     result_type operator()(Args ... args) {
-      auto result = mrb_funcall(mrb_, receiver_, name_.c_str(), sizeof ... (Args),
-              MRType<Args>::to_mrb_value(mrb_, args) ...);
+      return MRType<result_type>::to_c_value(mrb_, funcall(args ...));
+    }
+
+    /*!
+     * 呼び出し先のメソッドを固定した高速な呼び出しを返す. MRBoundFunction を参照.
+     */
+    MRBoundFunction<R(Args ...)> bind() const {
+      return MRBoundFunction<R(Args ...)>(mrb_, receiver_, name_);
+    }
 
+    /*!
+     * Rubyの例外を MRError として送出する.
+     * Rubyから呼ばれたメソッドの中 (mrb_state::jmp が設定済み) で使った場合, 例外は MRError にならず
+     * 呼び出し元を longjmp で越えて Ruby 側の rescue に伝わる.
+     */
+    result_type call_checked(Args ... args) {
+      mrb_->exc = nullptr;
+      auto result = funcall(args ...);
+      if (mrb_->exc) {
+        throw MRError::take(mrb_);
+      }
       return MRType<result_type>::to_c_value(mrb_, result);
     }
+
+    /*!
+     * Rubyの例外を MRExpected のエラーとして返す.
+     */
+    MRExpected<result_type> try_call(Args ... args) {
+      mrb_->exc = nullptr;
+      auto result = funcall(args ...);
+      if (mrb_->exc) {
+        return MRExpected<result_type>(MRError::take(mrb_));
+      }
+      return expected(result);
+    }
+
+  private:
+    mrb_value funcall(Args ... args) {
+      mrb_value argv[sizeof ... (Args) + 1] = {
+        MRType<Args>::to_mrb_value(mrb_, args) ..., mrb_nil_value()
+      };
+      return mrb_funcall_argv(mrb_, receiver_, name_, sizeof ... (Args), argv);
+    }
+
+    // 明示的インスタンス化で使わない側を実体化しないようメンバテンプレートにする
+    template<typename U = result_type>
+    typename std::enable_if<!std::is_void<U>::value, MRExpected<U> >::type expected(mrb_value result) {
+      return MRExpected<U>(MRType<U>::to_c_value(mrb_, result));
+    }
+
+    template<typename U = result_type>
+    typename std::enable_if<std::is_void<U>::value, MRExpected<U> >::type expected(mrb_value) {
+      return MRExpected<U>();
+    }
 };
+
+/*!
+ * MRFunction::bind() の結果. Rubyで定義したメソッドの手続きを直接呼び出す.
+ *
+ * 生成時にメソッドを探索し, Rubyで定義されていること (cfuncでないこと) と引数の数を確認する.
+ * 呼び出しはメソッド探索と可変長引数の変換を行わず mrb_yield_with_class で手続きを実行する.
+ * 生成後にメソッドを再定義しても反映されないため, 再度 bind() すること.
+ * super を使うメソッドには使用しないこと.
+ */
+template<typename R, typename ... Args>
+class MRBoundFunction<R(Args ...)> {
+  // 手続きをGCから保護する. コピー間で共有する
+  struct Binding {
+    mrb_state *mrb;
+    mrb_value proc;
+
+    ~Binding() {
+      mrb_gc_unregister(mrb, proc);
+    }
+  };
+
+  mrb_state *mrb_;
+  mrb_value receiver_;
+  RClass *target_;
+  std::shared_ptr<Binding> binding_;
+
+  public:
+    typedef R result_type;
+
+    MRBoundFunction(mrb_state *mrb, mrb_value receiver, mrb_sym name);
+
+    result_type operator()(Args ... args) {
+      return MRType<result_type>::to_c_value(mrb_, call(args ...));
+    }
+
+    /*!
+     * Rubyの例外を MRError として送出する.
+     * Rubyから呼ばれたメソッドの中 (mrb_state::jmp が設定済み) で使った場合, 例外は MRError にならず
+     * 呼び出し元を longjmp で越えて Ruby 側の rescue に伝わる.
+     */
+    result_type call_checked(Args ... args) {
+      mrb_->exc = nullptr;
+      auto result = call(args ...);
+      if (mrb_->exc) {
+        throw MRError::take(mrb_);
+      }
+      return MRType<result_type>::to_c_value(mrb_, result);
+    }
+
+  private:
+    mrb_value call(Args ... args);
+};
+
+template<typename R, typename ... Args>
+MRBoundFunction<R(Args ...)>::MRBoundFunction(mrb_state *mrb, mrb_value receiver, mrb_sym name)
+  : mrb_(mrb), receiver_(receiver), target_(mrb_class(mrb, receiver)) {
+  mrb_int length;
+  auto method_name = [&]() {
+    return std::string(mrb_sym2name_len(mrb, name, &length), length);
+  };
+
+  auto proc = mrb_method_search_vm(mrb, &target_, name);
+  if (!proc) {
+    throw MRError("NoMethodError", "undefined method '" + method_name() + "'");
+  }
+  if (MRB_PROC_CFUNC_P(proc)) {
+    throw MRError("TypeError", "'" + method_name() + "' is not defined in Ruby");
+  }
+
+  // 省略可能な引数があれば arity は負
+  auto arity = mrb_fixnum(mrb_funcall(mrb, mrb_obj_value(proc), "arity", 0));
+  mrb_int argc = sizeof ... (Args);
+  if (arity >= 0 ? arity != argc : -arity - 1 > argc) {
+    throw MRError("ArgumentError", "wrong number of arguments for '" + method_name() + "'");
+  }
+
+  binding_ = std::make_shared<Binding>();
+  binding_->mrb = mrb;
+  binding_->proc = mrb_obj_value(proc);
+  mrb_gc_register(mrb, binding_->proc);
+}
+
+template<typename R, typename ... Args>
+mrb_value MRBoundFunction<R(Args ...)>::call(Args ... args) {
+  mrb_value argv[sizeof ... (Args) + 1] = {
+    MRType<Args>::to_mrb_value(mrb_, args) ..., mrb_nil_value()
+  };
+  return MRExceptions::protect(mrb_, [&]() {
+        return mrb_yield_with_class(mrb_, binding_->proc, sizeof ... (Args), argv, receiver_, target_);
+      });
+}
 }  // namespace mrbind
 #endif  // INCLUDE_MRBIND_MR_FUNCTION_HPP__
 
@@ -0,0 +1,122 @@
+#ifndef INCLUDE_MRBIND_MR_GC_HPP__
+#define INCLUDE_MRBIND_MR_GC_HPP__
+#include <mruby.h>
+#include <mruby/gc.h>
+
+#include <chrono>
+#include <cstddef>
+
+namespace mrbind {
+/*!
+ * GCの統計. 停止時間は MRGC から実行したGCについてのみ計測する.
+ */
+struct MRGCStats {
+  std::size_t live_objects;
+  std::size_t heap_pages;
+  std::size_t collections;
+  std::chrono::nanoseconds last_pause;
+  std::chrono::nanoseconds max_pause;
+  std::chrono::nanoseconds total_pause;
+
+  MRGCStats()
+    : live_objects(0), heap_pages(0), collections(0),
+      last_pause(0), max_pause(0), total_pause(0) {
+  }
+};
+
+/*!
+ * GCの設定と実行. MRuby::gc() で取得する.
+ *
+ * 設定はRubyのGCモジュールを経由して行う. リクエストの合間に start() で完全GCを,
+ * step() でインクリメンタルGCの1ステップを実行し, その停止時間を記録する.
+ */
+class MRGC {
+  mrb_state *state_;
+
+  public:
+    explicit MRGC(mrb_state *state)
+      : state_(state) {
+    }
+
+    MRGC &generational(bool enabled) {
+      call("generational_mode=", mrb_bool_value(enabled));
+      return *this;
+    }
+
+    MRGC &interval_ratio(int ratio) {
+      call("interval_ratio=", mrb_fixnum_value(ratio));
+      return *this;
+    }
+
+    MRGC &step_ratio(int ratio) {
+      call("step_ratio=", mrb_fixnum_value(ratio));
+      return *this;
+    }
+
+    MRGC &enable() {
+      call("enable");
+      return *this;
+    }
+
+    MRGC &disable() {
+      call("disable");
+      return *this;
+    }
+
+    bool is_generational() const {
+      return mrb_test(mrb_funcall(state_, module(), "generational_mode", 0));
+    }
+
+    MRGC &start() {
+      measure(mrb_full_gc);
+      return *this;
+    }
+
+    MRGC &step() {
+      measure(mrb_incremental_gc);
+      return *this;
+    }
+
+    MRGCStats stats() const {
+      auto result = pauses();
+      result.live_objects = state_->gc.live;
+      for (auto page = state_->gc.heaps; page; page = page->next) {
+        result.heap_pages++;
+      }
+      return result;
+    }
+
+  private:
+    mrb_value module() const {
+      return mrb_obj_value(mrb_module_get(state_, "GC"));
+    }
+
+    void call(const char *name) {
+      mrb_funcall(state_, module(), name, 0);
+    }
+
+    void call(const char *name, mrb_value arg) {
+      mrb_funcall(state_, module(), name, 1, arg);
+    }
+
+    MRGCStats &pauses() const {
+      return MRStateData::get(state_)->slot<MRGCStats>();
+    }
+
+    void measure(void (*collect)(mrb_state *)) {
+      auto start = std::chrono::steady_clock::now();
+      collect(state_);
+      auto pause = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start);
+
+      auto &stats = pauses();
+      stats.collections++;
+      stats.last_pause = pause;
+      stats.total_pause += pause;
+      if (stats.max_pause < pause) {
+        stats.max_pause = pause;
+      }
+    }
+};
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_GC_HPP__
@@ -0,0 +1,70 @@
+#ifndef INCLUDE_MRBIND_MR_HASH_HPP__
+#define INCLUDE_MRBIND_MR_HASH_HPP__
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/hash.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+
+namespace mrbind {
+/*!
+ * 連想コンテナとRubyのHashの相互変換.
+ * Hashは要素数で事前確保し, 要素ごとにGC arenaを元に戻す.
+ */
+template<typename Map>
+struct MRHashType {
+  typedef mrb_value argument_type;
+  typedef typename Map::key_type key_type;
+  typedef typename Map::mapped_type mapped_type;
+
+  static Map expand_argument(mrb_state *state, argument_type arg) {
+    return to_c_value(state, arg);
+  }
+
+  static Map to_c_value(mrb_state *state, mrb_value v) {
+    if (!mrb_hash_p(v)) {
+      MRExceptions::raise(state, "TypeError", std::string("expected Hash, got ") + mrb_obj_classname(state, v));
+    }
+    Map result;
+    auto keys = mrb_hash_keys(state, v);
+    int ai = mrb_gc_arena_save(state);
+    for (mrb_int i = 0; i < RARRAY_LEN(keys); i++) {
+      auto key = mrb_ary_ref(state, keys, i);
+      result.insert(typename Map::value_type(
+            MRType<key_type>::to_c_value(state, key),
+            MRType<mapped_type>::to_c_value(state, mrb_hash_get(state, v, key))));
+      mrb_gc_arena_restore(state, ai);
+    }
+    return result;
+  }
+
+  static mrb_value to_mrb_value(mrb_state *state, const Map &v) {
+    auto hash = mrb_hash_new_capa(state, v.size());
+    int ai = mrb_gc_arena_save(state);
+    for (const auto &kv : v) {
+      mrb_hash_set(state, hash,
+          MRType<key_type>::to_mrb_value(state, kv.first),
+          MRType<mapped_type>::to_mrb_value(state, kv.second));
+      mrb_gc_arena_restore(state, ai);
+    }
+    return hash;
+  }
+
+  static std::string arg_char() {
+    return "H";
+  }
+};
+
+template<typename K, typename V, typename C, typename A>
+struct MRType<std::map<K, V, C, A> >
+  : MRHashType<std::map<K, V, C, A> > {
+};
+
+template<typename K, typename V, typename H, typename E, typename A>
+struct MRType<std::unordered_map<K, V, H, E, A> >
+  : MRHashType<std::unordered_map<K, V, H, E, A> > {
+};
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_HASH_HPP__
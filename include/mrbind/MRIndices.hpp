@@ -0,0 +1,23 @@
+#ifndef INCLUDE_MRBIND_MR_INDICES_HPP__
+#define INCLUDE_MRBIND_MR_INDICES_HPP__
+#include <cstddef>
+
+namespace mrbind {
+/*!
+ * 可変長引数をmrb_valueの配列から展開するための添字列.
+ * MRMakeIndices<3>::type は MRIndices<0, 1, 2> になる.
+ */
+template<std::size_t ... Is>
+struct MRIndices {
+};
+
+template<std::size_t N, std::size_t ... Is>
+struct MRMakeIndices : MRMakeIndices<N - 1, N - 1, Is ...> {
+};
+
+template<std::size_t ... Is>
+struct MRMakeIndices<0, Is ...> {
+  typedef MRIndices<Is ...> type;
+};
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_INDICES_HPP__
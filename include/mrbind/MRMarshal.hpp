@@ -0,0 +1,632 @@
+#ifndef INCLUDE_MRBIND_MR_MARSHAL_HPP__
+#define INCLUDE_MRBIND_MR_MARSHAL_HPP__
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/data.h>
+#include <mruby/hash.h>
+#include <mruby/string.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * MRMarshal のバッファへの書き込み. 整数は可変長で書き込む.
+ */
+class MRWriter {
+  std::string &buffer_;
+
+  public:
+    explicit MRWriter(std::string &buffer)
+      : buffer_(buffer) {
+    }
+
+    void put_byte(std::uint8_t b) {
+      buffer_.push_back(static_cast<char>(b));
+    }
+
+    void put_uint(std::uint64_t n) {
+      while (n >= 0x80) {
+        put_byte(static_cast<std::uint8_t>(n | 0x80));
+        n >>= 7;
+      }
+      put_byte(static_cast<std::uint8_t>(n));
+    }
+
+    void put_int(std::int64_t n) {
+      put_uint((static_cast<std::uint64_t>(n) << 1) ^ static_cast<std::uint64_t>(n >> 63));
+    }
+
+    void put_bytes(const void *p, std::size_t size) {
+      buffer_.append(static_cast<const char *>(p), size);
+    }
+
+    void put_string(const char *p, std::size_t size) {
+      put_uint(size);
+      put_bytes(p, size);
+    }
+
+    template<typename T>
+    void put(const T &v) {
+      static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+      put_bytes(&v, sizeof(T));
+    }
+};
+
+/*!
+ * MRMarshal のバッファからの読み込み. 範囲外の読み込みは MRError(ArgumentError) を送出する.
+ */
+class MRReader {
+  const char *p_;
+  const char *end_;
+
+  public:
+    MRReader(const char *data, std::size_t size)
+      : p_(data), end_(data + size) {
+    }
+
+    bool eof() const {
+      return p_ == end_;
+    }
+
+    std::uint8_t get_byte() {
+      require(1);
+      return static_cast<std::uint8_t>(*p_++);
+    }
+
+    std::uint64_t get_uint() {
+      std::uint64_t n = 0;
+      for (int shift = 0; shift < 64; shift += 7) {
+        auto b = get_byte();
+        n |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+          return n;
+        }
+      }
+      throw MRError("ArgumentError", "marshal data has a malformed integer");
+    }
+
+    std::int64_t get_int() {
+      auto n = get_uint();
+      return static_cast<std::int64_t>(n >> 1) ^ -static_cast<std::int64_t>(n & 1);
+    }
+
+    const char *get_bytes(std::size_t size) {
+      require(size);
+      auto p = p_;
+      p_ += size;
+      return p;
+    }
+
+    std::size_t get_string(const char **p) {
+      auto size = get_uint();
+      *p = get_bytes(size);
+      return size;
+    }
+
+    template<typename T>
+    T get() {
+      static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+      T v;
+      std::memcpy(&v, get_bytes(sizeof(T)), sizeof(T));
+      return v;
+    }
+
+  private:
+    void require(std::size_t size) const {
+      if (static_cast<std::size_t>(end_ - p_) < size) {
+        throw MRError("ArgumentError", "marshal data too short");
+      }
+    }
+};
+
+/*!
+ * mrb_value のグラフのバイナリ変換と, mrb_state間の直接コピー.
+ *
+ * nil, true, false, Fixnum, Float, String, Symbol, Array, Hash と,
+ * copyable() / serializable() で登録した MRClass<T> のオブジェクトを扱う.
+ * 同じオブジェクトへの複数の参照や循環参照はそのまま再現する.
+ * インスタンス変数, Hashのデフォルト値, 特異メソッドはコピーしない.
+ *
+ * バッファと参照表はインスタンスごとに再利用するため, 1つの MRMarshal を使い回すこと.
+ * copyable() / serializable() の登録はプロセス共通で, 別のスレッドの dump() / load() と並行して呼べる.
+ * load() は読み込む側の mrb_state で定義したクラス名でフックを探す.
+ * 形式は同じビルドのプロセス内での受け渡し用で, 永続化には使用しないこと.
+ */
+class MRMarshal {
+  public:
+    /*!
+     * v を buffer に書き込む. buffer の内容は置き換えられるが確保済みの領域は再利用する.
+     */
+    void dump(mrb_state *state, mrb_value v, std::string &buffer);
+
+    /*!
+     * dump() の結果から値を生成する.
+     */
+    mrb_value load(mrb_state *state, const char *data, std::size_t size);
+
+    mrb_value load(mrb_state *state, const std::string &buffer) {
+      return load(state, buffer.data(), buffer.size());
+    }
+
+    /*!
+     * src の v を dst に直接コピーする. バッファを経由しない.
+     */
+    mrb_value copy(mrb_state *src, mrb_value v, mrb_state *dst);
+
+    /*!
+     * MRClass<T> のオブジェクトをコピー可能にする. コピーには T のコピーコンストラクタを使う.
+     * dump() / load() は T がトリビアルにコピー可能な場合のみ使用でき, バイト列をそのまま書き込む.
+     */
+    template<typename T>
+    static void copyable();
+
+    /*!
+     * MRClass<T> のオブジェクトを write / read で dump() / load() 可能にする.
+     * copy() には T のコピーコンストラクタを使う.
+     */
+    template<typename T>
+    static void serializable(std::function<void(MRWriter &, const T &)> write,
+        std::function<T(MRReader &)> read);
+
+  private:
+    enum Tag : std::uint8_t {
+      TAG_NIL, TAG_TRUE, TAG_FALSE, TAG_FIXNUM, TAG_FLOAT, TAG_STRING,
+      TAG_SYMBOL, TAG_SYMBOL_REF, TAG_ARRAY, TAG_HASH, TAG_DATA, TAG_REF,
+    };
+
+    // MRClass<T> ごとのコピー処理. name は mrb_state ごとのクラス名
+    struct Hook {
+      const mrb_data_type *type;
+      const mrb_data_type *batch_type;
+      const mrb_data_type *borrowed_type;
+      const std::string &(*name)(mrb_state *);
+      std::function<void(MRWriter &, const void *)> write;
+      std::function<void *(MRReader &)> read;
+      void *(*clone)(const void *);
+      mrb_value (*wrap)(mrb_state *, void *);
+    };
+    typedef std::shared_ptr<const Hook> HookPtr;
+
+    // 登録済みのフック. 置き換えたフックも使用中の HookPtr が残る間は解放しない
+    struct Registry {
+      std::mutex mutex;
+      std::vector<HookPtr> hooks;
+    };
+
+    static Registry &registry() {
+      static Registry registry;
+      return registry;
+    }
+
+    template<typename T>
+    static void add_hook(std::function<void(MRWriter &, const void *)> write,
+        std::function<void *(MRReader &)> read);
+
+    static HookPtr find_hook(const mrb_data_type *type);
+    static HookPtr find_hook(mrb_state *state, const char *name, std::size_t size);
+    static HookPtr require_hook(mrb_state *state, mrb_value v);
+
+    template<typename T>
+    static mrb_value wrap(mrb_state *state, void *p);
+
+    void write_value(mrb_state *state, MRWriter &w, mrb_value v);
+    mrb_value read_value(mrb_state *state, MRReader &r);
+    mrb_value copy_value(mrb_state *src, mrb_value v, mrb_state *dst);
+    void clear();
+
+    // 書き込み済みのオブジェクトとシンボルの番号
+    std::unordered_map<const void *, std::uint32_t> written_;
+    std::unordered_map<mrb_sym, std::uint32_t> written_syms_;
+
+    // 読み込み済みのオブジェクトとシンボル
+    std::vector<mrb_value> read_;
+    std::vector<mrb_sym> read_syms_;
+
+    // copy() でのコピー元とコピー先の対応
+    std::unordered_map<const void *, mrb_value> copied_;
+    std::unordered_map<mrb_sym, mrb_sym> copied_syms_;
+};
+
+template<typename T>
+void MRMarshal::copyable() {
+  std::function<void(MRWriter &, const void *)> write;
+  std::function<void *(MRReader &)> read;
+  if (std::is_trivially_copyable<T>::value) {
+    write = [](MRWriter &w, const void *p) {
+          w.put_bytes(p, sizeof(T));
+        };
+    read = [](MRReader &r) -> void * {
+          typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+          std::memcpy(&storage, r.get_bytes(sizeof(T)), sizeof(T));
+          return new T(*reinterpret_cast<const T *>(&storage));
+        };
+  }
+  add_hook<T>(write, read);
+}
+
+template<typename T>
+void MRMarshal::serializable(std::function<void(MRWriter &, const T &)> write,
+    std::function<T(MRReader &)> read) {
+  add_hook<T>([write](MRWriter &w, const void *p) {
+        write(w, *static_cast<const T *>(p));
+      }, [read](MRReader &r) -> void * {
+        return new T(read(r));
+      });
+}
+
+template<typename T>
+void MRMarshal::add_hook(std::function<void(MRWriter &, const void *)> write,
+    std::function<void *(MRReader &)> read) {
+  HookPtr hook = std::make_shared<Hook>(Hook{
+    &MRClass<T>::data_type, &MRClass<T>::batch_data_type, &MRClass<T>::borrowed_data_type,
+    &MRClass<T>::name,
+    write, read,
+    [](const void *p) -> void * {
+      return new T(*static_cast<const T *>(p));
+    },
+    &MRMarshal::wrap<T>,
+  });
+  auto &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  auto it = std::find_if(reg.hooks.begin(), reg.hooks.end(), [](const HookPtr &h) {
+        return h->type == &MRClass<T>::data_type;
+      });
+  if (it != reg.hooks.end()) {
+    *it = hook;
+  } else {
+    reg.hooks.push_back(hook);
+  }
+}
+
+template<typename T>
+mrb_value MRMarshal::wrap(mrb_state *state, void *p) {
+  auto rclass = MRClass<T>::get_class(state);
+  if (!rclass) {
+    delete static_cast<T *>(p);
+    throw MRError("TypeError", MRClass<T>::class_name + " is not installed");
+  }
+  return mrb_obj_value(mrb_data_object_alloc(state, rclass, p, &MRClass<T>::data_type));
+}
+
+inline MRMarshal::HookPtr MRMarshal::find_hook(const mrb_data_type *type) {
+  auto &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (const auto &h : reg.hooks) {
+    if (h->type == type || h->batch_type == type || h->borrowed_type == type) {
+      return h;
+    }
+  }
+  return nullptr;
+}
+
+inline MRMarshal::HookPtr MRMarshal::find_hook(mrb_state *state, const char *name, std::size_t size) {
+  auto &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (const auto &h : reg.hooks) {
+    const auto &installed = h->name(state);
+    if (!installed.empty() && installed.size() == size && std::memcmp(installed.data(), name, size) == 0) {
+      return h;
+    }
+  }
+  return nullptr;
+}
+
+inline MRMarshal::HookPtr MRMarshal::require_hook(mrb_state *state, mrb_value v) {
+  auto hook = find_hook(DATA_TYPE(v));
+  if (!hook) {
+    throw MRError("TypeError", std::string("cannot copy ") + mrb_obj_classname(state, v));
+  }
+  return hook;
+}
+
+inline void MRMarshal::clear() {
+  written_.clear();
+  written_syms_.clear();
+  read_.clear();
+  read_syms_.clear();
+  copied_.clear();
+  copied_syms_.clear();
+}
+
+inline void MRMarshal::dump(mrb_state *state, mrb_value v, std::string &buffer) {
+  buffer.clear();
+  MRWriter w(buffer);
+  int ai = mrb_gc_arena_save(state);
+  try {
+    write_value(state, w, v);
+  } catch (...) {
+    mrb_gc_arena_restore(state, ai);
+    clear();
+    throw;
+  }
+  mrb_gc_arena_restore(state, ai);
+  clear();
+}
+
+inline mrb_value MRMarshal::load(mrb_state *state, const char *data, std::size_t size) {
+  MRReader r(data, size);
+  int ai = mrb_gc_arena_save(state);
+  mrb_value result;
+  try {
+    result = read_value(state, r);
+    if (!r.eof()) {
+      throw MRError("ArgumentError", "marshal data has trailing bytes");
+    }
+  } catch (...) {
+    mrb_gc_arena_restore(state, ai);
+    clear();
+    throw;
+  }
+  mrb_gc_arena_restore(state, ai);
+  mrb_gc_protect(state, result);
+  clear();
+  return result;
+}
+
+inline mrb_value MRMarshal::copy(mrb_state *src, mrb_value v, mrb_state *dst) {
+  int src_ai = mrb_gc_arena_save(src);
+  int dst_ai = mrb_gc_arena_save(dst);
+  mrb_value result;
+  try {
+    result = copy_value(src, v, dst);
+  } catch (...) {
+    mrb_gc_arena_restore(src, src_ai);
+    mrb_gc_arena_restore(dst, dst_ai);
+    clear();
+    throw;
+  }
+  mrb_gc_arena_restore(src, src_ai);
+  mrb_gc_arena_restore(dst, dst_ai);
+  mrb_gc_protect(dst, result);
+  clear();
+  return result;
+}
+
+inline void MRMarshal::write_value(mrb_state *state, MRWriter &w, mrb_value v) {
+  switch (mrb_type(v)) {
+    case MRB_TT_FALSE:
+      w.put_byte(mrb_nil_p(v) ? TAG_NIL : TAG_FALSE);
+      return;
+    case MRB_TT_TRUE:
+      w.put_byte(TAG_TRUE);
+      return;
+    case MRB_TT_FIXNUM:
+      w.put_byte(TAG_FIXNUM);
+      w.put_int(mrb_fixnum(v));
+      return;
+    case MRB_TT_FLOAT:
+      w.put_byte(TAG_FLOAT);
+      w.put(mrb_float(v));
+      return;
+    case MRB_TT_SYMBOL: {
+      auto sym = mrb_symbol(v);
+      auto it = written_syms_.find(sym);
+      if (it != written_syms_.end()) {
+        w.put_byte(TAG_SYMBOL_REF);
+        w.put_uint(it->second);
+        return;
+      }
+      written_syms_.emplace(sym, static_cast<std::uint32_t>(written_syms_.size()));
+      mrb_int len;
+      auto name = mrb_sym2name_len(state, sym, &len);
+      w.put_byte(TAG_SYMBOL);
+      w.put_string(name, len);
+      return;
+    }
+    case MRB_TT_STRING:
+    case MRB_TT_ARRAY:
+    case MRB_TT_HASH:
+    case MRB_TT_DATA:
+      break;
+    default:
+      throw MRError("TypeError", std::string("cannot dump ") + mrb_obj_classname(state, v));
+  }
+
+  // 2回目以降は番号で参照する
+  auto it = written_.find(mrb_ptr(v));
+  if (it != written_.end()) {
+    w.put_byte(TAG_REF);
+    w.put_uint(it->second);
+    return;
+  }
+  HookPtr hook;
+  if (mrb_type(v) == MRB_TT_DATA) {
+    hook = require_hook(state, v);
+    if (!hook->write) {
+      throw MRError("TypeError", std::string("cannot dump ") + mrb_obj_classname(state, v));
+    }
+  }
+  written_.emplace(mrb_ptr(v), static_cast<std::uint32_t>(written_.size()));
+
+  switch (mrb_type(v)) {
+    case MRB_TT_STRING:
+      w.put_byte(TAG_STRING);
+      w.put_string(RSTRING_PTR(v), RSTRING_LEN(v));
+      break;
+    case MRB_TT_ARRAY: {
+      auto len = RARRAY_LEN(v);
+      w.put_byte(TAG_ARRAY);
+      w.put_uint(len);
+      for (mrb_int i = 0; i < len; i++) {
+        write_value(state, w, RARRAY_PTR(v)[i]);
+      }
+      break;
+    }
+    case MRB_TT_HASH: {
+      auto keys = mrb_hash_keys(state, v);
+      auto len = RARRAY_LEN(keys);
+      w.put_byte(TAG_HASH);
+      w.put_uint(len);
+      for (mrb_int i = 0; i < len; i++) {
+        auto key = RARRAY_PTR(keys)[i];
+        write_value(state, w, key);
+        write_value(state, w, mrb_hash_get(state, v, key));
+      }
+      break;
+    }
+    default:
+      w.put_byte(TAG_DATA);
+      const auto &name = hook->name(state);
+      w.put_string(name.data(), name.size());
+      hook->write(w, DATA_PTR(v));
+      break;
+  }
+}
+
+inline mrb_value MRMarshal::read_value(mrb_state *state, MRReader &r) {
+  switch (r.get_byte()) {
+    case TAG_NIL:
+      return mrb_nil_value();
+    case TAG_TRUE:
+      return mrb_true_value();
+    case TAG_FALSE:
+      return mrb_false_value();
+    case TAG_FIXNUM:
+      return mrb_fixnum_value(static_cast<mrb_int>(r.get_int()));
+    case TAG_FLOAT:
+      return mrb_float_value(state, r.get<mrb_float>());
+    case TAG_SYMBOL: {
+      const char *name;
+      auto len = r.get_string(&name);
+      read_syms_.push_back(mrb_intern(state, name, len));
+      return mrb_symbol_value(read_syms_.back());
+    }
+    case TAG_SYMBOL_REF: {
+      auto index = r.get_uint();
+      if (index >= read_syms_.size()) {
+        throw MRError("ArgumentError", "marshal data has a bad symbol reference");
+      }
+      return mrb_symbol_value(read_syms_[index]);
+    }
+    case TAG_REF: {
+      auto index = r.get_uint();
+      if (index >= read_.size()) {
+        throw MRError("ArgumentError", "marshal data has a bad object reference");
+      }
+      return read_[index];
+    }
+    case TAG_STRING: {
+      const char *p;
+      auto len = r.get_string(&p);
+      read_.push_back(mrb_str_new(state, p, len));
+      return read_.back();
+    }
+    case TAG_ARRAY: {
+      auto len = r.get_uint();
+      auto ary = mrb_ary_new_capa(state, static_cast<mrb_int>(std::min<std::uint64_t>(len, 1024)));
+      read_.push_back(ary);
+      for (std::uint64_t i = 0; i < len; i++) {
+        int ai = mrb_gc_arena_save(state);
+        mrb_ary_push(state, ary, read_value(state, r));
+        mrb_gc_arena_restore(state, ai);
+      }
+      return ary;
+    }
+    case TAG_HASH: {
+      auto len = r.get_uint();
+      auto hash = mrb_hash_new_capa(state, static_cast<mrb_int>(std::min<std::uint64_t>(len, 1024)));
+      read_.push_back(hash);
+      for (std::uint64_t i = 0; i < len; i++) {
+        int ai = mrb_gc_arena_save(state);
+        auto key = read_value(state, r);
+        mrb_hash_set(state, hash, key, read_value(state, r));
+        mrb_gc_arena_restore(state, ai);
+      }
+      return hash;
+    }
+    case TAG_DATA: {
+      const char *name;
+      auto len = r.get_string(&name);
+      auto hook = find_hook(state, name, len);
+      if (!hook || !hook->read) {
+        throw MRError("TypeError", "cannot load " + std::string(name, len));
+      }
+      read_.push_back(hook->wrap(state, hook->read(r)));
+      return read_.back();
+    }
+    default:
+      throw MRError("ArgumentError", "marshal data has an unknown tag");
+  }
+}
+
+inline mrb_value MRMarshal::copy_value(mrb_state *src, mrb_value v, mrb_state *dst) {
+  switch (mrb_type(v)) {
+    case MRB_TT_FALSE:
+    case MRB_TT_TRUE:
+    case MRB_TT_FIXNUM:
+      return v;
+    case MRB_TT_FLOAT:
+      return mrb_float_value(dst, mrb_float(v));
+    case MRB_TT_SYMBOL: {
+      auto it = copied_syms_.find(mrb_symbol(v));
+      if (it == copied_syms_.end()) {
+        mrb_int len;
+        auto name = mrb_sym2name_len(src, mrb_symbol(v), &len);
+        it = copied_syms_.emplace(mrb_symbol(v), mrb_intern(dst, name, len)).first;
+      }
+      return mrb_symbol_value(it->second);
+    }
+    case MRB_TT_STRING:
+    case MRB_TT_ARRAY:
+    case MRB_TT_HASH:
+    case MRB_TT_DATA:
+      break;
+    default:
+      throw MRError("TypeError", std::string("cannot copy ") + mrb_obj_classname(src, v));
+  }
+
+  auto it = copied_.find(mrb_ptr(v));
+  if (it != copied_.end()) {
+    return it->second;
+  }
+
+  switch (mrb_type(v)) {
+    case MRB_TT_STRING: {
+      auto str = mrb_str_new(dst, RSTRING_PTR(v), RSTRING_LEN(v));
+      copied_.emplace(mrb_ptr(v), str);
+      return str;
+    }
+    case MRB_TT_ARRAY: {
+      auto len = RARRAY_LEN(v);
+      auto ary = mrb_ary_new_capa(dst, len);
+      copied_.emplace(mrb_ptr(v), ary);
+      for (mrb_int i = 0; i < len; i++) {
+        int ai = mrb_gc_arena_save(dst);
+        mrb_ary_push(dst, ary, copy_value(src, RARRAY_PTR(v)[i], dst));
+        mrb_gc_arena_restore(dst, ai);
+      }
+      return ary;
+    }
+    case MRB_TT_HASH: {
+      auto keys = mrb_hash_keys(src, v);
+      auto len = RARRAY_LEN(keys);
+      auto hash = mrb_hash_new_capa(dst, len);
+      copied_.emplace(mrb_ptr(v), hash);
+      for (mrb_int i = 0; i < len; i++) {
+        int ai = mrb_gc_arena_save(dst);
+        auto key = RARRAY_PTR(keys)[i];
+        auto k = copy_value(src, key, dst);
+        mrb_hash_set(dst, hash, k, copy_value(src, mrb_hash_get(src, v, key), dst));
+        mrb_gc_arena_restore(dst, ai);
+      }
+      return hash;
+    }
+    default: {
+      auto hook = require_hook(src, v);
+      auto obj = hook->wrap(dst, hook->clone(DATA_PTR(v)));
+      copied_.emplace(mrb_ptr(v), obj);
+      return obj;
+    }
+  }
+}
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_MARSHAL_HPP__
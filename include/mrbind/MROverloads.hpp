@@ -0,0 +1,131 @@
+#ifndef INCLUDE_MRBIND_MR_OVERLOADS_HPP__
+#define INCLUDE_MRBIND_MR_OVERLOADS_HPP__
+#include <mruby.h>
+#include <mruby/proc.h>
+#include <mruby/string.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * 同名メソッドの多重定義. mrb_stateごとに (クラス, 名前) 単位で登録を保持する.
+ *
+ * 1つ目の定義はそのまま mrb_define_method で登録する. 2つ目以降の定義があると
+ * 引数の数と mrb_type の事前計算した表から定義を選ぶディスパッチャに置き換える.
+ * 複数の定義に合致する場合は先に登録したものを優先する.
+ */
+class MROverloads {
+  struct Overload {
+    mrb_func_t func;
+    mrb_int argc;
+    std::vector<std::uint32_t> masks;
+
+    bool matches(mrb_int n, const mrb_value *argv) const {
+      if (n != argc) {
+        return false;
+      }
+      for (mrb_int i = 0; i < n; i++) {
+        if (!((masks[i] >> mrb_type(argv[i])) & 1)) {
+          return false;
+        }
+      }
+      return true;
+    }
+  };
+
+  struct Set {
+    std::string name;
+    std::vector<Overload> overloads;
+  };
+
+  typedef std::map<std::pair<RClass *, std::string>, Set> Registry;
+
+  public:
+    /*!
+     * format は mrb_get_args の書式. "&" はブロックのため引数の数に含めない.
+     */
+    static void define(mrb_state *state, RClass *rclass, const std::string &name,
+        mrb_func_t func, const std::string &format, mrb_aspec aspec);
+
+  private:
+    static mrb_value dispatch(mrb_state *state, mrb_value self);
+
+    // mrb_get_args の書式文字が受け付ける型
+    static std::uint32_t type_mask(char ch) {
+      switch (ch) {
+        case 'i':
+        case 'f':
+          return (1u << MRB_TT_FIXNUM) | (1u << MRB_TT_FLOAT);
+        case 's':
+        case 'S':
+        case 'z':
+          return 1u << MRB_TT_STRING;
+        case 'n':
+          return (1u << MRB_TT_SYMBOL) | (1u << MRB_TT_STRING);
+        case 'A':
+          return 1u << MRB_TT_ARRAY;
+        case 'H':
+          return 1u << MRB_TT_HASH;
+        default:
+          return ~0u;
+      }
+    }
+};
+
+inline void MROverloads::define(mrb_state *state, RClass *rclass, const std::string &name,
+    mrb_func_t func, const std::string &format, mrb_aspec aspec) {
+  Overload overload = { func, 0, std::vector<std::uint32_t>() };
+  for (auto ch : format) {
+    if (ch != '&') {
+      overload.masks.push_back(type_mask(ch));
+    }
+  }
+  overload.argc = overload.masks.size();
+
+  auto &set = MRStateData::get(state)->slot<Registry>()[std::make_pair(rclass, name)];
+  set.name = name;
+
+  // 同じ引数の定義は置き換える
+  bool replaced = false;
+  for (auto &o : set.overloads) {
+    if (o.argc == overload.argc && o.masks == overload.masks) {
+      o.func = func;
+      replaced = true;
+    }
+  }
+  if (!replaced) {
+    set.overloads.push_back(overload);
+  }
+
+  if (set.overloads.size() == 1) {
+    mrb_define_method(state, rclass, name.c_str(), func, aspec);
+    return;
+  }
+  mrb_value env = mrb_cptr_value(state, &set);
+  auto proc = mrb_proc_new_cfunc_with_env(state, dispatch, 1, &env);
+  mrb_define_method_raw(state, rclass, mrb_intern(state, name.data(), name.size()), proc);
+}
+
+inline mrb_value MROverloads::dispatch(mrb_state *state, mrb_value self) {
+  auto set = static_cast<const Set *>(mrb_cptr(mrb_cfunc_env_get(state, 0)));
+
+  mrb_value *argv;
+  mrb_int argc;
+  mrb_get_args(state, "*", &argv, &argc);
+  for (const auto &o : set->overloads) {
+    if (o.matches(argc, argv)) {
+      return o.func(state, self);
+    }
+  }
+
+  mrb_raisef(state, mrb_class_get(state, "ArgumentError"),
+      "no overload of '%S' matches %S arguments",
+      mrb_str_new(state, set->name.data(), set->name.size()), mrb_fixnum_value(argc));
+  return mrb_nil_value();
+}
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_OVERLOADS_HPP__
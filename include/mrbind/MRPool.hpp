@@ -0,0 +1,277 @@
+#ifndef INCLUDE_MRBIND_MR_POOL_HPP__
+#define INCLUDE_MRBIND_MR_POOL_HPP__
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/class.h>
+#include <mruby/variable.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * mrb_stateのトップレベルの状態の記録と復元. MRuby::snapshot() / MRuby::reset() から使う.
+ *
+ * 記録の対象はグローバル変数, トップレベルのインスタンス変数, Objectの定数とObjectに定義したメソッド.
+ * restore() は記録後に追加されたものを削除し, 値や定義が置き換えられたものを記録時の値に戻す.
+ * オブジェクトの中身の変更や, Object以外のクラスへのメソッド追加は元に戻さない.
+ */
+class MRBaseline {
+  typedef std::unordered_map<mrb_sym, mrb_value> Values;
+
+  Values globals_;
+  Values ivars_;
+  Values constants_;
+  std::unordered_map<mrb_sym, RProc *> methods_;
+
+  // 記録した値をGCから保護する
+  mrb_value keep_;
+  bool captured_;
+
+  public:
+    MRBaseline()
+      : keep_(mrb_nil_value()), captured_(false) {
+    }
+
+    bool captured() const {
+      return captured_;
+    }
+
+    void capture(mrb_state *state);
+    void restore(mrb_state *state);
+
+  private:
+    static mrb_value call(mrb_state *state, mrb_value receiver, const char *name);
+    static mrb_value call(mrb_state *state, mrb_value receiver, const char *name, mrb_value arg);
+};
+
+inline mrb_value MRBaseline::call(mrb_state *state, mrb_value receiver, const char *name) {
+  return mrb_funcall(state, receiver, name, 0);
+}
+
+inline mrb_value MRBaseline::call(mrb_state *state, mrb_value receiver, const char *name, mrb_value arg) {
+  return mrb_funcall(state, receiver, name, 1, arg);
+}
+
+inline void MRBaseline::capture(mrb_state *state) {
+  if (captured_) {
+    mrb_gc_unregister(state, keep_);
+  }
+  globals_.clear();
+  ivars_.clear();
+  constants_.clear();
+  methods_.clear();
+
+  int ai = mrb_gc_arena_save(state);
+  keep_ = mrb_ary_new(state);
+  auto self = mrb_obj_value(state->top_self);
+  auto object = mrb_obj_value(state->object_class);
+
+  auto gvs = call(state, self, "global_variables");
+  for (mrb_int i = 0; i < RARRAY_LEN(gvs); i++) {
+    auto sym = mrb_symbol(RARRAY_PTR(gvs)[i]);
+    auto v = mrb_gv_get(state, sym);
+    globals_[sym] = v;
+    mrb_ary_push(state, keep_, v);
+  }
+  auto ivs = call(state, self, "instance_variables");
+  for (mrb_int i = 0; i < RARRAY_LEN(ivs); i++) {
+    auto sym = mrb_symbol(RARRAY_PTR(ivs)[i]);
+    auto v = mrb_iv_get(state, self, sym);
+    ivars_[sym] = v;
+    mrb_ary_push(state, keep_, v);
+  }
+  auto consts = call(state, object, "constants");
+  for (mrb_int i = 0; i < RARRAY_LEN(consts); i++) {
+    auto sym = mrb_symbol(RARRAY_PTR(consts)[i]);
+    auto v = mrb_const_get(state, object, sym);
+    constants_[sym] = v;
+    mrb_ary_push(state, keep_, v);
+  }
+  auto methods = call(state, object, "instance_methods", mrb_false_value());
+  for (mrb_int i = 0; i < RARRAY_LEN(methods); i++) {
+    auto sym = mrb_symbol(RARRAY_PTR(methods)[i]);
+    auto c = state->object_class;
+    auto proc = mrb_method_search_vm(state, &c, sym);
+    if (proc) {
+      methods_[sym] = proc;
+      mrb_ary_push(state, keep_, mrb_obj_value(proc));
+    }
+  }
+
+  mrb_gc_register(state, keep_);
+  mrb_gc_arena_restore(state, ai);
+  captured_ = true;
+}
+
+inline void MRBaseline::restore(mrb_state *state) {
+  if (!captured_) {
+    return;
+  }
+  int ai = mrb_gc_arena_save(state);
+  auto self = mrb_obj_value(state->top_self);
+  auto object = mrb_obj_value(state->object_class);
+  auto state_data = mrb_intern_lit(state, "$__mrbind_state__");
+
+  auto gvs = call(state, self, "global_variables");
+  for (mrb_int i = 0; i < RARRAY_LEN(gvs); i++) {
+    auto sym = mrb_symbol(RARRAY_PTR(gvs)[i]);
+    if (!globals_.count(sym) && sym != state_data) {
+      mrb_gv_remove(state, sym);
+    }
+  }
+  for (const auto &g : globals_) {
+    mrb_gv_set(state, g.first, g.second);
+  }
+
+  auto ivs = call(state, self, "instance_variables");
+  for (mrb_int i = 0; i < RARRAY_LEN(ivs); i++) {
+    auto sym = mrb_symbol(RARRAY_PTR(ivs)[i]);
+    if (!ivars_.count(sym)) {
+      mrb_iv_remove(state, self, sym);
+    }
+  }
+  for (const auto &iv : ivars_) {
+    mrb_iv_set(state, self, iv.first, iv.second);
+  }
+
+  auto consts = call(state, object, "constants");
+  for (mrb_int i = 0; i < RARRAY_LEN(consts); i++) {
+    auto sym = mrb_symbol(RARRAY_PTR(consts)[i]);
+    auto it = constants_.find(sym);
+    if (it == constants_.end()) {
+      mrb_const_remove(state, object, sym);
+    } else if (!mrb_obj_equal(state, mrb_const_get(state, object, sym), it->second)) {
+      mrb_const_set(state, object, sym, it->second);
+    }
+  }
+
+  auto methods = call(state, object, "instance_methods", mrb_false_value());
+  for (mrb_int i = 0; i < RARRAY_LEN(methods); i++) {
+    auto sym = mrb_symbol(RARRAY_PTR(methods)[i]);
+    if (!methods_.count(sym)) {
+      call(state, object, "remove_method", mrb_symbol_value(sym));
+    }
+  }
+  for (const auto &m : methods_) {
+    auto c = state->object_class;
+    if (mrb_method_search_vm(state, &c, m.first) != m.second || c != state->object_class) {
+      mrb_define_method_raw(state, state->object_class, m.first, m.second);
+    }
+  }
+
+  state->exc = nullptr;
+  mrb_gc_arena_restore(state, ai);
+}
+
+/*!
+ * 初期化済みの MRuby のプール.
+ *
+ * checkout() で貸し出し, Lease の破棄時に MRuby::reset() でトップレベルの状態を
+ * 初期化直後の状態に戻してから返却する. 空の場合は返却を待つ. スレッド間で共有できる.
+ * 返却先の状態は Lease と共有するため, Lease がプールより後に破棄されてもよい.
+ * 返却時に未完了の非同期タスクは破棄され, 貸し出し中に watch_file() したファイルは監視対象から外れる.
+ *
+ *   mrbind::MRPool pool(8, [](mrbind::MRuby &mruby) {
+ *         mruby.install_class<Person>("Person", person_methods);
+ *       });
+ *   auto mruby = pool.checkout();
+ *   mruby->load_string(request);
+ */
+class MRPool {
+  // 貸し出し中の Lease と共有する返却先
+  struct Shared {
+    std::mutex mutex;
+    std::condition_variable returned;
+    std::vector<std::unique_ptr<MRuby> > idle;
+
+    void give_back(std::unique_ptr<MRuby> mruby);
+  };
+
+  public:
+    typedef std::function<void(MRuby &)> Initializer;
+
+    class Lease {
+      std::shared_ptr<Shared> pool_;
+      std::unique_ptr<MRuby> mruby_;
+
+      public:
+        Lease(std::shared_ptr<Shared> pool, std::unique_ptr<MRuby> mruby)
+          : pool_(std::move(pool)), mruby_(std::move(mruby)) {
+        }
+
+        Lease(Lease &&other)
+          : pool_(std::move(other.pool_)), mruby_(std::move(other.mruby_)) {
+        }
+
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+
+        ~Lease() {
+          if (mruby_) {
+            pool_->give_back(std::move(mruby_));
+          }
+        }
+
+        MRuby &operator*() const {
+          return *mruby_;
+        }
+
+        MRuby *operator->() const {
+          return mruby_.get();
+        }
+    };
+
+    MRPool(std::size_t size, Initializer initialize = nullptr);
+
+    Lease checkout();
+
+    std::size_t available() const {
+      std::lock_guard<std::mutex> lock(shared_->mutex);
+      return shared_->idle.size();
+    }
+
+  private:
+    std::shared_ptr<Shared> shared_;
+};
+
+inline MRPool::MRPool(std::size_t size, Initializer initialize)
+  : shared_(std::make_shared<Shared>()) {
+  shared_->idle.reserve(size);
+  for (std::size_t i = 0; i < size; i++) {
+    std::unique_ptr<MRuby> mruby(new MRuby());
+    if (initialize) {
+      initialize(*mruby);
+    }
+    mruby->snapshot();
+    shared_->idle.push_back(std::move(mruby));
+  }
+}
+
+inline MRPool::Lease MRPool::checkout() {
+  auto &shared = *shared_;
+  std::unique_lock<std::mutex> lock(shared.mutex);
+  shared.returned.wait(lock, [&shared]() {
+        return !shared.idle.empty();
+      });
+  auto mruby = std::move(shared.idle.back());
+  shared.idle.pop_back();
+  return Lease(shared_, std::move(mruby));
+}
+
+inline void MRPool::Shared::give_back(std::unique_ptr<MRuby> mruby) {
+  mruby->reset();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    idle.push_back(std::move(mruby));
+  }
+  returned.notify_one();
+}
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_POOL_HPP__
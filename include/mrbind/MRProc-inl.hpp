@@ -0,0 +1,80 @@
+#ifndef INCLUDE_MRBIND_MR_PROC_INL_HPP__
+#define INCLUDE_MRBIND_MR_PROC_INL_HPP__
+#include <mruby.h>
+#include <mruby/data.h>
+#include <mruby/proc.h>
+
+#include <functional>
+#include <tuple>
+#include <type_traits>
+
+namespace mrbind {
+template<typename R, typename ... Args>
+template<typename F>
+mrb_value MRProcTrampoline<R(Args ...)>::make(mrb_state *state, F f) {
+  typedef std::integral_constant<bool,
+          std::is_convertible<F, function_pointer>::value
+          && (std::is_empty<F>::value || std::is_pointer<F>::value)> is_stateless;
+  return make(state, f, is_stateless());
+}
+
+template<typename R, typename ... Args>
+template<typename F>
+mrb_value MRProcTrampoline<R(Args ...)>::make(mrb_state *state, F f, std::true_type) {
+  function_pointer fp = f;
+  mrb_value env = mrb_cptr_value(state, reinterpret_cast<void *>(fp));
+  return mrb_obj_value(mrb_proc_new_cfunc_with_env(state, call_function, 1, &env));
+}
+
+template<typename R, typename ... Args>
+template<typename F>
+mrb_value MRProcTrampoline<R(Args ...)>::make(mrb_state *state, F f, std::false_type) {
+  auto holder = mrb_data_object_alloc(state, state->object_class, new F(f), &Holder<F>::data_type);
+  mrb_value env = mrb_obj_value(holder);
+  return mrb_obj_value(mrb_proc_new_cfunc_with_env(state, call_object<F>, 1, &env));
+}
+
+template<typename R, typename ... Args>
+mrb_value MRProcTrampoline<R(Args ...)>::call_function(mrb_state *state, mrb_value) {
+  auto fp = reinterpret_cast<function_pointer>(mrb_cptr(mrb_cfunc_env_get(state, 0)));
+  return invoke(state, fp);
+}
+
+template<typename R, typename ... Args>
+template<typename F>
+mrb_value MRProcTrampoline<R(Args ...)>::call_object(mrb_state *state, mrb_value) {
+  auto f = static_cast<F *>(DATA_PTR(mrb_cfunc_env_get(state, 0)));
+  return invoke(state, *f);
+}
+
+template<typename R, typename ... Args>
+template<typename F>
+mrb_value MRProcTrampoline<R(Args ...)>::invoke(mrb_state *state, F &f) {
+  return invoke(state, f, typename MRMakeIndices<sizeof ... (Args)>::type());
+}
+
+template<typename R, typename ... Args>
+template<typename F, std::size_t ... Is>
+mrb_value MRProcTrampoline<R(Args ...)>::invoke(mrb_state *state, F &f, MRIndices<Is ...>) {
+  // メソッドと同じく mrb_get_args で取得し, 引数の数と型を検査する
+  std::tuple<typename MRType<typename std::decay<Args>::type>::argument_type ...> args{};
+  mrb_get_args(state, MRuby::args_format_string<typename std::decay<Args>::type ...>().c_str(),
+      &std::get<Is>(args) ...);
+  return MRExceptions::guard(state, [&]() {
+        return MRMethodResult<R>::invoke(state, [&]() {
+              return f(MRType<typename std::decay<Args>::type>::expand_argument(state, std::get<Is>(args)) ...);
+            });
+      });
+}
+
+template<typename F>
+mrb_value make_proc(mrb_state *state, F f) {
+  typedef typename MRCallableTraits<F>::signature signature;
+  auto proc = MRProcTrampoline<signature>::make(state, f);
+  if (MRIsAsync<typename std::function<signature>::result_type>::value) {
+    return MRStateData::get(state)->slot<MRScheduler>().wrap_async(state, proc);
+  }
+  return proc;
+}
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_PROC_INL_HPP__
@@ -0,0 +1,88 @@
+#ifndef INCLUDE_MRBIND_MR_PROC_HPP__
+#define INCLUDE_MRBIND_MR_PROC_HPP__
+#include <mruby.h>
+#include <mruby/data.h>
+#include <mruby/proc.h>
+
+#include <type_traits>
+
+#include "MRIndices.hpp"
+
+namespace mrbind {
+/*!
+ * 呼び出し可能オブジェクトのシグネチャ. 関数ポインタ, ラムダ, std::functionに対応する.
+ */
+template<typename F>
+struct MRCallableTraits : MRCallableTraits<decltype(&F::operator())> {
+};
+
+template<typename R, typename ... Args>
+struct MRCallableTraits<R (*)(Args ...)> {
+  typedef R signature(Args ...);
+};
+
+template<typename C, typename R, typename ... Args>
+struct MRCallableTraits<R (C::*)(Args ...)> {
+  typedef R signature(Args ...);
+};
+
+template<typename C, typename R, typename ... Args>
+struct MRCallableTraits<R (C::*)(Args ...) const> {
+  typedef R signature(Args ...);
+};
+
+template<typename _Signature>
+struct MRProcTrampoline;
+
+/*!
+ * C++の呼び出し可能オブジェクトをRubyのProcにする.
+ *
+ * 呼び出し可能オブジェクトはProcのenvに格納し, シグネチャから生成した
+ * cfuncを経由して呼び出す. キャプチャの無いラムダや関数ポインタは
+ * 関数ポインタとしてenvに格納するため, ヒープ確保は発生しない.
+ */
+template<typename R, typename ... Args>
+struct MRProcTrampoline<R(Args ...)> {
+  typedef R (*function_pointer)(Args ...);
+
+  template<typename F>
+  static mrb_value make(mrb_state *state, F f);
+
+  private:
+    template<typename F>
+    struct Holder {
+      static const mrb_data_type data_type;
+
+      static void free_instance(mrb_state *, void *ptr) {
+        delete static_cast<F *>(ptr);
+      }
+    };
+
+    template<typename F>
+    static mrb_value make(mrb_state *state, F f, std::true_type);
+
+    template<typename F>
+    static mrb_value make(mrb_state *state, F f, std::false_type);
+
+    static mrb_value call_function(mrb_state *state, mrb_value self);
+
+    template<typename F>
+    static mrb_value call_object(mrb_state *state, mrb_value self);
+
+    template<typename F>
+    static mrb_value invoke(mrb_state *state, F &f);
+
+    template<typename F, std::size_t ... Is>
+    static mrb_value invoke(mrb_state *state, F &f, MRIndices<Is ...>);
+};
+
+template<typename R, typename ... Args>
+template<typename F>
+const mrb_data_type MRProcTrampoline<R(Args ...)>::Holder<F>::data_type = {
+  "MRProc", MRProcTrampoline<R(Args ...)>::Holder<F>::free_instance
+};
+
+template<typename F>
+mrb_value make_proc(mrb_state *state, F f);
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_PROC_HPP__
@@ -0,0 +1,66 @@
+#ifndef INCLUDE_MRBIND_MR_RANGE_INL_HPP__
+#define INCLUDE_MRBIND_MR_RANGE_INL_HPP__
+#include <mruby.h>
+#include <mruby/class.h>
+#include <mruby/data.h>
+
+namespace mrbind {
+template<typename Iterator>
+struct MRRangeHolder : MRRangeClass::Holder {
+  typedef typename MRRange<Iterator>::value_type value_type;
+
+  MRRange<Iterator> range;
+
+  explicit MRRangeHolder(const MRRange<Iterator> &r)
+    : range(r) {
+  }
+
+  // break で抜けた場合はこのフレームが巻き戻されずに破棄されるため,
+  // ループ内ではデストラクタを持つオブジェクトを生成しない
+  void each(mrb_state *state, mrb_value block) const {
+    int ai = mrb_gc_arena_save(state);
+    for (Iterator it = range.begin(); it != range.end(); ++it) {
+      mrb_yield(state, block, MRType<value_type>::to_mrb_value(state, *it));
+      mrb_gc_arena_restore(state, ai);
+    }
+  }
+};
+
+inline const mrb_data_type *MRRangeClass::data_type() {
+  static const mrb_data_type type = { "MRRange", free_holder };
+  return &type;
+}
+
+inline RClass *MRRangeClass::get(mrb_state *state) {
+  if (mrb_class_defined(state, name())) {
+    return mrb_class_get(state, name());
+  }
+  RClass *rclass = mrb_define_class(state, name(), state->object_class);
+  MRB_SET_INSTANCE_TT(rclass, MRB_TT_DATA);
+  mrb_include_module(state, rclass, mrb_module_get(state, "Enumerable"));
+  mrb_define_method(state, rclass, "each", each, ARGS_NONE());
+  return rclass;
+}
+
+inline mrb_value MRRangeClass::wrap(mrb_state *state, Holder *holder) {
+  return mrb_obj_value(mrb_data_object_alloc(state, get(state), holder, data_type()));
+}
+
+inline mrb_value MRRangeClass::each(mrb_state *state, mrb_value self) {
+  mrb_value block;
+  mrb_get_args(state, "&", &block);
+  if (mrb_nil_p(block)) {
+    return mrb_funcall(state, self, "to_enum", 0);
+  }
+
+  auto holder = static_cast<const Holder *>(mrb_data_get_ptr(state, self, data_type()));
+  holder->each(state, block);
+  return self;
+}
+
+template<typename Iterator>
+mrb_value MRType<MRRange<Iterator> >::to_mrb_value(mrb_state *state, const MRRange<Iterator> &v) {
+  return MRRangeClass::wrap(state, new MRRangeHolder<Iterator>(v));
+}
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_RANGE_INL_HPP__
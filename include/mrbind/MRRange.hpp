@@ -0,0 +1,83 @@
+#ifndef INCLUDE_MRBIND_MR_RANGE_HPP__
+#define INCLUDE_MRBIND_MR_RANGE_HPP__
+#include <mruby.h>
+#include <mruby/data.h>
+
+#include <iterator>
+
+namespace mrbind {
+/*!
+ * C++のイテレータ範囲. RubyにはEnumerableをincludeしたMRRangeオブジェクトとして渡される.
+ *
+ * 要素は each で yield する時点で1つずつ MRType により変換されるため,
+ * Array への事前コピーは発生しない. break や first(n) で途中終了できる.
+ * 範囲の元となるコンテナの寿命は呼び出し側で管理すること.
+ */
+template<typename Iterator>
+class MRRange {
+  Iterator first_;
+  Iterator last_;
+
+  public:
+    typedef typename std::iterator_traits<Iterator>::value_type value_type;
+
+    MRRange(Iterator first, Iterator last)
+      : first_(first), last_(last) {
+    }
+
+    Iterator begin() const {
+      return first_;
+    }
+
+    Iterator end() const {
+      return last_;
+    }
+};
+
+template<typename Iterator>
+MRRange<Iterator> make_range(Iterator first, Iterator last) {
+  return MRRange<Iterator>(first, last);
+}
+
+template<typename Container>
+MRRange<typename Container::const_iterator> make_range(const Container &c) {
+  return MRRange<typename Container::const_iterator>(c.begin(), c.end());
+}
+
+/*!
+ * Ruby側のMRRangeクラス. mrb_stateごとに初回使用時に定義される.
+ *
+ * - each() はブロックを受け取り, 範囲の要素を順に yield する
+ * - ブロックが無い場合は to_enum(:each) を返す
+ */
+struct MRRangeClass {
+  static const char *name() {
+    return "MRRange";
+  }
+
+  // 型を消去した範囲の保持者
+  struct Holder {
+    virtual ~Holder() {}
+    virtual void each(mrb_state *state, mrb_value block) const = 0;
+  };
+
+  static const mrb_data_type *data_type();
+
+  static RClass *get(mrb_state *state);
+  static mrb_value wrap(mrb_state *state, Holder *holder);
+
+  private:
+    static mrb_value each(mrb_state *state, mrb_value self);
+
+    static void free_holder(mrb_state *, void *ptr) {
+      delete static_cast<Holder *>(ptr);
+    }
+};
+
+template<typename Iterator>
+struct MRType<MRRange<Iterator> > {
+  // 戻り値専用
+  static mrb_value to_mrb_value(mrb_state *state, const MRRange<Iterator> &v);
+};
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_RANGE_HPP__
@@ -0,0 +1,245 @@
+#ifndef INCLUDE_MRBIND_MR_SCRIPT_SET_HPP__
+#define INCLUDE_MRBIND_MR_SCRIPT_SET_HPP__
+#include <mruby.h>
+#include <mruby/compile.h>
+#include <mruby/proc.h>
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * 監視対象のスクリプトファイルの集合. MRStateData に保持する.
+ *
+ * reload() は各ファイルの内容のハッシュ値を比較し, 変更されたファイルだけを再コンパイルする.
+ * 更新時刻とサイズが前回から変わらないファイルは読み込まない.
+ * 変更されたファイルが全てコンパイルできた場合に限り, 登録順に実行してメソッド定義を置き換える.
+ * 実行中に例外が発生した場合, そのファイルと以降のファイルは反映済みとせず, 次の reload() で再実行する.
+ * watch() の最初の実行に失敗したファイルも同様に, 次の reload() で再実行する.
+ * コンパイル済みのコードはファイルごとに保持し, restore() で再コンパイルせずに再実行できる.
+ */
+class MRScriptSet {
+  // ファイルの更新時刻とサイズ. checked は記録した時刻
+  struct Stamp {
+    std::time_t mtime;
+    std::int64_t size;
+    std::time_t checked;
+  };
+
+  struct Script {
+    std::string filename;
+    std::uint64_t hash;
+    mrb_value proc;
+    Stamp stamp;
+    bool applied;
+  };
+
+  std::vector<Script> scripts_;
+  std::size_t baseline_ = 0;
+
+  public:
+    /*!
+     * ファイルを監視対象に加えて実行する. 実行結果を返す.
+     * 読み込めない場合は監視対象に加えずに nil を返し, mrb_state::exc に例外を設定する.
+     */
+    mrb_value watch(mrb_state *state, const std::string &filename);
+
+    /*!
+     * 変更されたファイルを再読み込みし, 再実行に成功したファイル数を返す.
+     * コンパイルエラーの場合は何も実行せずに0を返し, mrb_state::exc に例外を設定する.
+     */
+    std::size_t reload(mrb_state *state);
+
+    /*!
+     * 反映済みのコンパイル済みのコードを全て登録順に再実行する.
+     */
+    void restore(mrb_state *state);
+
+    std::size_t size() const {
+      return scripts_.size();
+    }
+
+    /*!
+     * mark() 以降に watch() したファイルを監視対象から外す. MRuby::snapshot() / reset() から使う.
+     * mark() 以前のファイルを reload() した結果は戻さない.
+     */
+    void mark() {
+      baseline_ = scripts_.size();
+    }
+
+    void rollback(mrb_state *state);
+
+    static std::uint64_t hash(const std::string &str) {
+      std::uint64_t h = 14695981039346656037ull;
+      for (auto ch : str) {
+        h = (h ^ static_cast<unsigned char>(ch)) * 1099511628211ull;
+      }
+      return h;
+    }
+
+  private:
+    static bool read(const std::string &filename, std::string *content);
+    static bool stat(const std::string &filename, Stamp *stamp);
+
+    // 同じ秒のうちに書き換えられた場合に備え, 記録した時刻より前の更新時刻だけを信用する
+    static bool unchanged(const Stamp &last, const Stamp &now) {
+      return last.mtime == now.mtime && last.size == now.size && last.mtime < last.checked;
+    }
+
+    static mrb_value compile(mrb_state *state, const std::string &filename, const std::string &content);
+    static mrb_value run(mrb_state *state, mrb_value proc);
+
+    static mrb_value fail(mrb_state *state, const std::string &message) {
+      state->exc = mrb_obj_ptr(mrb_exc_new_str(state, mrb_class_get(state, "RuntimeError"),
+          mrb_str_new(state, message.data(), message.size())));
+      return mrb_nil_value();
+    }
+};
+
+inline mrb_value MRScriptSet::watch(mrb_state *state, const std::string &filename) {
+  Stamp stamp;
+  std::string content;
+  if (!stat(filename, &stamp) || !read(filename, &content)) {
+    return fail(state, "cannot read " + filename);
+  }
+
+  auto proc = compile(state, filename, content);
+  if (state->exc) {
+    return mrb_nil_value();
+  }
+  mrb_gc_register(state, proc);
+  scripts_.push_back(Script({ filename, hash(content), proc, stamp, false }));
+
+  // reload() と同じく, 実行に成功した場合だけ反映済みとする
+  auto result = run(state, proc);
+  if (!state->exc) {
+    scripts_.back().applied = true;
+  }
+  return result;
+}
+
+inline std::size_t MRScriptSet::reload(mrb_state *state) {
+  // 変更されたファイルと未反映のファイルを全てコンパイルしてから実行する
+  std::vector<std::pair<Script *, Script> > changed;
+  int ai = mrb_gc_arena_save(state);
+  for (auto &script : scripts_) {
+    Stamp stamp;
+    if (!stat(script.filename, &stamp)) {
+      continue;
+    }
+    if (script.applied && unchanged(script.stamp, stamp)) {
+      continue;
+    }
+    std::string content;
+    if (!read(script.filename, &content)) {
+      continue;
+    }
+    auto h = hash(content);
+    if (h == script.hash) {
+      script.stamp = stamp;
+      if (script.applied) {
+        continue;
+      }
+      changed.push_back(std::make_pair(&script, script));
+      continue;
+    }
+
+    auto proc = compile(state, script.filename, content);
+    if (state->exc) {
+      mrb_gc_arena_restore(state, ai);
+      return 0;
+    }
+    changed.push_back(std::make_pair(&script, Script({ script.filename, h, proc, stamp, false })));
+  }
+
+  // 実行に成功したファイルから順に反映する. 未反映の proc はアリーナで保護する
+  std::size_t count = 0;
+  int run_ai = mrb_gc_arena_save(state);
+  for (auto &c : changed) {
+    run(state, c.second.proc);
+    mrb_gc_arena_restore(state, run_ai);
+    if (state->exc) {
+      break;
+    }
+    if (!mrb_obj_equal(state, c.first->proc, c.second.proc)) {
+      mrb_gc_unregister(state, c.first->proc);
+      mrb_gc_register(state, c.second.proc);
+    }
+    *c.first = c.second;
+    c.first->applied = true;
+    count++;
+  }
+  mrb_gc_arena_restore(state, ai);
+  return count;
+}
+
+inline void MRScriptSet::rollback(mrb_state *state) {
+  while (scripts_.size() > baseline_) {
+    mrb_gc_unregister(state, scripts_.back().proc);
+    scripts_.pop_back();
+  }
+}
+
+inline void MRScriptSet::restore(mrb_state *state) {
+  int ai = mrb_gc_arena_save(state);
+  for (const auto &script : scripts_) {
+    if (!script.applied) {
+      continue;
+    }
+    run(state, script.proc);
+    if (state->exc) {
+      return;
+    }
+    mrb_gc_arena_restore(state, ai);
+  }
+}
+
+inline bool MRScriptSet::read(const std::string &filename, std::string *content) {
+  std::ifstream in(filename, std::ios::in | std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << in.rdbuf();
+  *content = ss.str();
+  return true;
+}
+
+inline bool MRScriptSet::stat(const std::string &filename, Stamp *stamp) {
+  struct stat st;
+  if (::stat(filename.c_str(), &st) != 0) {
+    return false;
+  }
+  stamp->mtime = st.st_mtime;
+  stamp->size = static_cast<std::int64_t>(st.st_size);
+  stamp->checked = std::time(nullptr);
+  return true;
+}
+
+inline mrb_value MRScriptSet::compile(mrb_state *state, const std::string &filename, const std::string &content) {
+  auto cxt = mrbc_context_new(state);
+  mrbc_filename(state, cxt, filename.c_str());
+  cxt->capture_errors = TRUE;
+  cxt->no_exec = TRUE;
+  auto proc = mrb_load_nstring_cxt(state, content.data(), content.size(), cxt);
+  mrbc_context_free(state, cxt);
+  return proc;
+}
+
+inline mrb_value MRScriptSet::run(mrb_state *state, mrb_value proc) {
+  auto p = mrb_proc_ptr(proc);
+#ifdef MRB_PROC_SET_TARGET_CLASS
+  MRB_PROC_SET_TARGET_CLASS(p, state->object_class);
+#else
+  p->target_class = state->object_class;
+#endif
+  return mrb_top_run(state, p, mrb_top_self(state), 0);
+}
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_SCRIPT_SET_HPP__
@@ -0,0 +1,76 @@
+#ifndef INCLUDE_MRBIND_MR_STATE_HPP__
+#define INCLUDE_MRBIND_MR_STATE_HPP__
+#include <mruby.h>
+#include <mruby/data.h>
+#include <mruby/variable.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * mrb_stateごとのmrbind用データ. mrb_state::ud に保持する.
+ *
+ * 型ごとに1つのスロットを持ち, slot<T>() で初回アクセス時に T を生成する.
+ * 本体はグローバル変数に保持したData型オブジェクトが所有し, mrb_close時に解放される.
+ */
+class MRStateData {
+  std::vector<std::shared_ptr<void> > slots_;
+
+  public:
+    static MRStateData *get(mrb_state *state);
+
+    template<typename T>
+    T &slot();
+
+  private:
+    static const mrb_data_type *data_type();
+
+    static void free_instance(mrb_state *state, void *ptr) {
+      delete static_cast<MRStateData *>(ptr);
+      state->ud = nullptr;
+    }
+
+    // 異なる型のスロットに複数のスレッドから同時に初回アクセスする場合があるため atomic にする
+    static std::atomic<std::size_t> &slot_count() {
+      static std::atomic<std::size_t> count(0);
+      return count;
+    }
+
+    template<typename T>
+    static std::size_t slot_index() {
+      static const std::size_t index = slot_count().fetch_add(1);
+      return index;
+    }
+};
+
+inline const mrb_data_type *MRStateData::data_type() {
+  static const mrb_data_type type = { "MRStateData", free_instance };
+  return &type;
+}
+
+inline MRStateData *MRStateData::get(mrb_state *state) {
+  if (!state->ud) {
+    auto data = new MRStateData();
+    auto obj = mrb_data_object_alloc(state, state->object_class, data, data_type());
+    mrb_gv_set(state, mrb_intern_cstr(state, "$__mrbind_state__"), mrb_obj_value(obj));
+    state->ud = data;
+  }
+  return static_cast<MRStateData *>(state->ud);
+}
+
+template<typename T>
+T &MRStateData::slot() {
+  auto index = slot_index<T>();
+  if (slots_.size() <= index) {
+    slots_.resize(index + 1);
+  }
+  if (!slots_[index]) {
+    slots_[index] = std::make_shared<T>();
+  }
+  return *static_cast<T *>(slots_[index].get());
+}
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_STATE_HPP__
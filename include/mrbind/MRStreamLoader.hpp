@@ -0,0 +1,261 @@
+#ifndef INCLUDE_MRBIND_MR_STREAM_LOADER_HPP__
+#define INCLUDE_MRBIND_MR_STREAM_LOADER_HPP__
+#include <mruby.h>
+#include <mruby/compile.h>
+#include <mruby/string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <string>
+
+namespace mrbind {
+/*!
+ * 大きなスクリプトの逐次実行. 入力全体を保持せずにトップレベルの文を順に構文解析して実行する.
+ *
+ * 入力を行単位で chunk_size 程度ずつ取り出して構文解析し, 成功したら実行して破棄する.
+ * 末尾の文が途中で切れている場合 (入力の終端に対する構文エラー) は取り出す量を倍にして再試行する.
+ * 倍にしてもエラーの行が進まない場合と, 取り出す量が max_statement を超える場合は構文エラーとする.
+ * 保持するのはテキスト, 構文木, irep のいずれも「chunk_size と最大の文の大きさの2倍」程度に収まる.
+ *
+ * - 文の区切りは改行の位置で判定するため, 次の行頭の . で続くメソッドチェーンは区切りをまたげない
+ * - ローカル変数は同じ入力の中でのみ引き継がれる
+ * - エラーは load_string() と同様に mrb_state::exc に設定し, 以降の文は実行しない
+ */
+class MRStreamLoader {
+  std::size_t chunk_size_;
+  std::size_t max_statement_;
+
+  public:
+    // chunk_size は1以上に切り上げる. max_statement は再試行で取り出す量の上限
+    explicit MRStreamLoader(std::size_t chunk_size = 1 << 20, std::size_t max_statement = 64 << 20)
+      : chunk_size_(std::max<std::size_t>(chunk_size, 1)), max_statement_(max_statement) {
+    }
+
+    /*!
+     * 入力ストリームから読み込んで実行する. 最後に実行した文の値を返す.
+     */
+    mrb_value load(mrb_state *state, std::istream &in, const std::string &filename = "-");
+
+    /*!
+     * ファイルをメモリマップして実行する. 実行済みの範囲のページは順に解放する.
+     */
+    mrb_value load_mapped(mrb_state *state, const std::string &filename);
+
+  private:
+    // std::istream から読み込んだ行を保持する
+    class StreamSource {
+      std::istream &in_;
+      std::string buffer_;
+      std::size_t window_;
+
+      public:
+        explicit StreamSource(std::istream &in)
+          : in_(in), window_(0) {
+        }
+
+        const char *data() const {
+          return buffer_.data();
+        }
+
+        std::size_t size() const {
+          return window_;
+        }
+
+        bool at_end() const {
+          return !in_ && window_ == buffer_.size();
+        }
+
+        void fill(std::size_t target);
+
+        void consume() {
+          buffer_.erase(0, window_);
+          window_ = 0;
+        }
+    };
+
+    // メモリマップしたファイル. consume() で実行済みのページを解放する
+    class MappedSource {
+      const char *data_;
+      std::size_t size_;
+      std::size_t begin_;
+      std::size_t end_;
+      std::size_t released_;
+
+      public:
+        MappedSource(const char *data, std::size_t size)
+          : data_(data), size_(size), begin_(0), end_(0), released_(0) {
+        }
+
+        const char *data() const {
+          return data_ + begin_;
+        }
+
+        std::size_t size() const {
+          return end_ - begin_;
+        }
+
+        bool at_end() const {
+          return end_ == size_;
+        }
+
+        void fill(std::size_t target);
+        void consume();
+    };
+
+    struct Mapping {
+      int fd = -1;
+      void *addr = MAP_FAILED;
+      std::size_t size = 0;
+
+      ~Mapping() {
+        if (addr != MAP_FAILED) {
+          munmap(addr, size);
+        }
+        if (fd >= 0) {
+          close(fd);
+        }
+      }
+    };
+
+    template<typename Source>
+    mrb_value run(mrb_state *state, Source &source, const std::string &filename);
+
+    static mrb_value fail(mrb_state *state, const std::string &message) {
+      state->exc = mrb_obj_ptr(mrb_exc_new_str(state, mrb_class_get(state, "RuntimeError"),
+          mrb_str_new(state, message.data(), message.size())));
+      return mrb_nil_value();
+    }
+};
+
+inline void MRStreamLoader::StreamSource::fill(std::size_t target) {
+  const std::size_t block = 64 * 1024;
+  while (true) {
+    // target 以上取り出せる場合は最後の改行までを対象にする
+    if (buffer_.size() >= target) {
+      auto nl = buffer_.rfind('\n');
+      if (nl != std::string::npos && nl + 1 > window_) {
+        window_ = nl + 1;
+        return;
+      }
+    }
+    if (!in_) {
+      window_ = buffer_.size();
+      return;
+    }
+    auto old = buffer_.size();
+    buffer_.resize(old + block);
+    in_.read(&buffer_[old], block);
+    buffer_.resize(old + static_cast<std::size_t>(in_.gcount()));
+  }
+}
+
+inline void MRStreamLoader::MappedSource::fill(std::size_t target) {
+  if (begin_ + target >= size_) {
+    end_ = size_;
+    return;
+  }
+  auto p = static_cast<const char *>(std::memchr(data_ + begin_ + target - 1, '\n', size_ - begin_ - target + 1));
+  end_ = p ? p - data_ + 1 : size_;
+}
+
+inline void MRStreamLoader::MappedSource::consume() {
+  begin_ = end_;
+  auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  auto release = begin_ / page * page;
+  if (release > released_) {
+    madvise(const_cast<char *>(data_) + released_, release - released_, MADV_DONTNEED);
+    released_ = release;
+  }
+}
+
+inline mrb_value MRStreamLoader::load(mrb_state *state, std::istream &in, const std::string &filename) {
+  StreamSource source(in);
+  return run(state, source, filename);
+}
+
+inline mrb_value MRStreamLoader::load_mapped(mrb_state *state, const std::string &filename) {
+  Mapping m;
+  m.fd = open(filename.c_str(), O_RDONLY);
+  struct stat st;
+  if (m.fd < 0 || fstat(m.fd, &st) != 0) {
+    return fail(state, "cannot read " + filename);
+  }
+  if (st.st_size == 0) {
+    return mrb_nil_value();
+  }
+  m.size = static_cast<std::size_t>(st.st_size);
+  m.addr = mmap(nullptr, m.size, PROT_READ, MAP_PRIVATE, m.fd, 0);
+  if (m.addr == MAP_FAILED) {
+    return fail(state, "cannot map " + filename);
+  }
+  madvise(m.addr, m.size, MADV_SEQUENTIAL);
+
+  MappedSource source(static_cast<const char *>(m.addr), m.size);
+  return run(state, source, filename);
+}
+
+template<typename Source>
+mrb_value MRStreamLoader::run(mrb_state *state, Source &source, const std::string &filename) {
+  auto cxt = mrbc_context_new(state);
+  mrbc_filename(state, cxt, filename.c_str());
+  cxt->capture_errors = TRUE;
+
+  int ai = mrb_gc_arena_save(state);
+  mrb_value result = mrb_nil_value();
+  int lineno = 1;
+  int error_line = 0;
+  std::size_t target = chunk_size_;
+  while (true) {
+    source.fill(target);
+    if (source.size() == 0) {
+      break;
+    }
+    if (source.size() > INT_MAX) {
+      fail(state, "statement too large in " + filename);
+      break;
+    }
+
+    cxt->lineno = lineno;
+    auto parser = mrb_parse_nstring(state, source.data(), static_cast<int>(source.size()), cxt);
+    if (!parser) {
+      fail(state, "cannot parse " + filename);
+      break;
+    }
+    int lines = static_cast<int>(std::count(source.data(), source.data() + source.size(), '\n'));
+
+    // 最後の行での構文エラーは文が途切れたものとみなし, 倍の量で再試行する.
+    // エラーの行が前回から進まない場合と上限に達した場合は, そのまま実行して SyntaxError とする
+    if (parser->nerr > 0 && !source.at_end() && parser->error_buffer[0].lineno >= lineno + lines - 1
+        && parser->error_buffer[0].lineno != error_line && source.size() < max_statement_) {
+      error_line = parser->error_buffer[0].lineno;
+      mrb_parser_free(parser);
+      target = source.size() * 2;
+      continue;
+    }
+
+    mrb_gc_arena_restore(state, ai);
+    result = mrb_load_exec(state, parser, cxt);
+    if (state->exc) {
+      result = mrb_nil_value();
+      break;
+    }
+    lineno += lines;
+    source.consume();
+    error_line = 0;
+    target = chunk_size_;
+  }
+  mrbc_context_free(state, cxt);
+  mrb_gc_arena_restore(state, ai);
+  mrb_gc_protect(state, result);
+  return result;
+}
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_STREAM_LOADER_HPP__
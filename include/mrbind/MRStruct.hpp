@@ -0,0 +1,140 @@
+#ifndef INCLUDE_MRBIND_MR_STRUCT_HPP__
+#define INCLUDE_MRBIND_MR_STRUCT_HPP__
+#include <mruby.h>
+#include <mruby/hash.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * 構造体のメンバ1つ分の定義. MRBIND_FIELD で生成する.
+ */
+template<typename T>
+struct MRField {
+  const char *name;
+  std::size_t length;
+  mrb_value (*get)(mrb_state *state, const T &obj);
+  void (*set)(mrb_state *state, T &obj, mrb_value v);
+
+  template<typename M, M T::*Member>
+  static mrb_value getter(mrb_state *state, const T &obj) {
+    return MRType<M>::to_mrb_value(state, obj.*Member);
+  }
+
+  template<typename M, M T::*Member>
+  static void setter(mrb_state *state, T &obj, mrb_value v) {
+    obj.*Member = MRType<M>::to_c_value(state, v);
+  }
+};
+
+template<typename T>
+struct MRFieldList {
+  const MRField<T> *fields;
+  std::size_t size;
+};
+
+/*!
+ * 構造体のメンバ一覧. MRBIND_STRUCT で特殊化する.
+ */
+template<typename T>
+struct MRStruct;
+
+/*!
+ * 構造体とシンボルをキーとするRubyのHashの相互変換.
+ *
+ * キーのシンボルはmrb_stateごとに1度だけinternする.
+ * Hashに存在しないキーのメンバは値初期化したまま (T() の値) となる.
+ */
+template<typename T>
+struct MRStructType {
+  typedef mrb_value argument_type;
+
+  static T expand_argument(mrb_state *state, argument_type arg) {
+    return to_c_value(state, arg);
+  }
+
+  static T to_c_value(mrb_state *state, mrb_value v) {
+    if (!mrb_hash_p(v)) {
+      MRExceptions::raise(state, "TypeError", std::string("expected Hash, got ") + mrb_obj_classname(state, v));
+    }
+    const auto &list = MRStruct<T>::fields();
+    auto syms = symbols(state);
+
+    T result = T();
+    int ai = mrb_gc_arena_save(state);
+    for (std::size_t i = 0; i < list.size; i++) {
+      auto field = mrb_hash_get(state, v, mrb_symbol_value(syms[i]));
+      if (!mrb_nil_p(field)) {
+        list.fields[i].set(state, result, field);
+      }
+      mrb_gc_arena_restore(state, ai);
+    }
+    return result;
+  }
+
+  static mrb_value to_mrb_value(mrb_state *state, const T &v) {
+    const auto &list = MRStruct<T>::fields();
+    auto syms = symbols(state);
+
+    auto hash = mrb_hash_new_capa(state, list.size);
+    int ai = mrb_gc_arena_save(state);
+    for (std::size_t i = 0; i < list.size; i++) {
+      mrb_hash_set(state, hash, mrb_symbol_value(syms[i]), list.fields[i].get(state, v));
+      mrb_gc_arena_restore(state, ai);
+    }
+    return hash;
+  }
+
+  static std::string arg_char() {
+    return "H";
+  }
+
+  private:
+    struct Symbols {
+      std::vector<mrb_sym> syms;
+    };
+
+    static const mrb_sym *symbols(mrb_state *state) {
+      auto &cache = MRStateData::get(state)->slot<Symbols>();
+      if (cache.syms.empty()) {
+        const auto &list = MRStruct<T>::fields();
+        for (std::size_t i = 0; i < list.size; i++) {
+          cache.syms.push_back(mrb_intern_static(state, list.fields[i].name, list.fields[i].length));
+        }
+      }
+      return cache.syms.data();
+    }
+};
+}  // namespace mrbind
+
+/*!
+ * 構造体のメンバ定義. MRBIND_STRUCT の引数に使う.
+ */
+#define MRBIND_FIELD(type, member) \
+  { #member, sizeof(#member) - 1, \
+    &mrbind::MRField<type>::getter<decltype(type::member), &type::member>, \
+    &mrbind::MRField<type>::setter<decltype(type::member), &type::member> }
+
+/*!
+ * 構造体をRubyのHashと相互変換できるようにする. グローバル名前空間で使用すること.
+ *
+ *   MRBIND_STRUCT(Point, MRBIND_FIELD(Point, x), MRBIND_FIELD(Point, y))
+ */
+#define MRBIND_STRUCT(type, ...) \
+  namespace mrbind { \
+  template<> \
+  struct MRStruct<type> { \
+    static const MRFieldList<type> &fields() { \
+      static const MRField<type> fields[] = { __VA_ARGS__ }; \
+      static const MRFieldList<type> list = { fields, sizeof(fields) / sizeof(fields[0]) }; \
+      return list; \
+    } \
+  }; \
+  template<> \
+  struct MRType<type> : MRStructType<type> { \
+  }; \
+  }
+
+#endif  // INCLUDE_MRBIND_MR_STRUCT_HPP__
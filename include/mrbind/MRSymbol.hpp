@@ -0,0 +1,117 @@
+#ifndef INCLUDE_MRBIND_MR_SYMBOL_HPP__
+#define INCLUDE_MRBIND_MR_SYMBOL_HPP__
+#include <mruby.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * コンパイル時にハッシュ値を計算したシンボル名. "name"_sym で生成する.
+ * 名前は文字列リテラルを指すため, mrb_intern_static でコピーせずにinternできる.
+ */
+class MRSymbolName {
+  const char *name_;
+  std::size_t length_;
+  std::uint32_t hash_;
+
+  public:
+    constexpr MRSymbolName(const char *name, std::size_t length)
+      : name_(name), length_(length), hash_(fnv1a(name, length)) {
+    }
+
+    constexpr const char *name() const {
+      return name_;
+    }
+
+    constexpr std::size_t length() const {
+      return length_;
+    }
+
+    constexpr std::uint32_t hash() const {
+      return hash_;
+    }
+
+    static constexpr std::uint32_t fnv1a(const char *s, std::size_t n, std::uint32_t h = 2166136261u) {
+      return n == 0 ? h : fnv1a(s + 1, n - 1, (h ^ static_cast<unsigned char>(*s)) * 16777619u);
+    }
+};
+
+namespace literals {
+constexpr MRSymbolName operator"" _sym(const char *name, std::size_t length) {
+  return MRSymbolName(name, length);
+}
+}  // namespace literals
+
+/*!
+ * mrb_stateごとのシンボルキャッシュ. コンパイル時のハッシュ値で開番地法のテーブルを引く.
+ */
+class MRSymbolCache {
+  struct Entry {
+    const char *name;
+    std::size_t length;
+    std::uint32_t hash;
+    mrb_sym sym;
+  };
+
+  std::vector<Entry> entries_;
+  std::size_t used_;
+
+  public:
+    MRSymbolCache()
+      : entries_(64, Entry()), used_(0) {
+    }
+
+    mrb_sym get(mrb_state *state, const MRSymbolName &name) {
+      auto mask = entries_.size() - 1;
+      for (auto i = name.hash() & mask; entries_[i].name; i = (i + 1) & mask) {
+        const auto &e = entries_[i];
+        if (e.hash == name.hash() && e.length == name.length()
+            && (e.name == name.name() || std::memcmp(e.name, name.name(), e.length) == 0)) {
+          return e.sym;
+        }
+      }
+
+      auto sym = mrb_intern_static(state, name.name(), name.length());
+      insert({ name.name(), name.length(), name.hash(), sym });
+      return sym;
+    }
+
+  private:
+    void insert(const Entry &entry) {
+      if ((used_ + 1) * 2 > entries_.size()) {
+        std::vector<Entry> old(entries_.size() * 2, Entry());
+        old.swap(entries_);
+        used_ = 0;
+        for (const auto &e : old) {
+          if (e.name) {
+            insert(e);
+          }
+        }
+      }
+
+      auto mask = entries_.size() - 1;
+      auto i = entry.hash & mask;
+      while (entries_[i].name) {
+        i = (i + 1) & mask;
+      }
+      entries_[i] = entry;
+      used_++;
+    }
+};
+
+inline mrb_sym sym(mrb_state *state, const MRSymbolName &name) {
+  return MRStateData::get(state)->slot<MRSymbolCache>().get(state, name);
+}
+
+template<>
+struct MRType<MRSymbolName> {
+  // 引数として渡す専用
+  static mrb_value to_mrb_value(mrb_state *state, const MRSymbolName &v) {
+    return mrb_symbol_value(sym(state, v));
+  }
+};
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_SYMBOL_HPP__
@@ -0,0 +1,649 @@
+#ifndef INCLUDE_MRBIND_MR_TABLE_HPP__
+#define INCLUDE_MRBIND_MR_TABLE_HPP__
+#include <mruby.h>
+#include <mruby/array.h>
+#include <mruby/class.h>
+#include <mruby/data.h>
+#include <mruby/hash.h>
+#include <mruby/string.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mrbind {
+/*!
+ * 所有しない文字列の参照. MRTable の文字列の列に使う.
+ */
+struct MRStringRef {
+  const char *data;
+  std::size_t size;
+
+  MRStringRef()
+    : data(""), size(0) {
+  }
+
+  MRStringRef(const char *d, std::size_t s)
+    : data(d), size(s) {
+  }
+
+  MRStringRef(const std::string &s)
+    : data(s.data()), size(s.size()) {
+  }
+
+  int compare(const MRStringRef &other) const {
+    int c = std::memcmp(data, other.data, size < other.size ? size : other.size);
+    return c ? c : (size < other.size ? -1 : size > other.size ? 1 : 0);
+  }
+
+  struct Hash {
+    std::size_t operator()(const MRStringRef &s) const {
+      std::size_t h = 2166136261u;
+      for (std::size_t i = 0; i < s.size; i++) {
+        h = (h ^ static_cast<unsigned char>(s.data[i])) * 16777619u;
+      }
+      return h;
+    }
+  };
+};
+
+inline bool operator==(const MRStringRef &a, const MRStringRef &b) {
+  return a.size == b.size && std::memcmp(a.data, b.data, a.size) == 0;
+}
+inline bool operator!=(const MRStringRef &a, const MRStringRef &b) {
+  return !(a == b);
+}
+inline bool operator<(const MRStringRef &a, const MRStringRef &b) {
+  return a.compare(b) < 0;
+}
+inline bool operator<=(const MRStringRef &a, const MRStringRef &b) {
+  return a.compare(b) <= 0;
+}
+inline bool operator>(const MRStringRef &a, const MRStringRef &b) {
+  return a.compare(b) > 0;
+}
+inline bool operator>=(const MRStringRef &a, const MRStringRef &b) {
+  return a.compare(b) >= 0;
+}
+
+/*!
+ * 列指向の表. 行数と, 各列の先頭要素へのポインタを登録する.
+ *
+ * 列のデータはコピーしないため, Rubyから参照される間は呼び出し側で寿命を管理すること.
+ * Rubyには MRTable オブジェクトとして渡され, 以下のメソッドを持つ.
+ *
+ * - size, columns
+ * - where(col, value) / where(col, op, value) : op は :==, :!=, :<, :<=, :>, :>=. 行を絞り込んだ表を返す
+ * - sum(col) : 数値の列の合計
+ * - group_by(col) : 値ごとに絞り込んだ表の Hash. ブロックを渡した場合は Enumerable#group_by
+ * - Enumerable のメソッドは各行の Hash に対して動作する
+ * - map_column(col) { |v| ... } : 列の値ごとのブロックの結果の Array. ブロックが無ければ値の Array
+ * - row(i), to_a, each : 行を列名をキーとする Hash として生成する
+ *
+ * row(), to_a, each 以外は行のオブジェクトを生成せず, 列に対するC++のループで処理する.
+ */
+class MRTable {
+  public:
+    enum ColumnType {
+      COLUMN_INT, COLUMN_DOUBLE, COLUMN_STRING, COLUMN_STRING_REF,
+    };
+
+    struct Column {
+      std::string name;
+      ColumnType type;
+      const void *data;
+    };
+
+    struct Data {
+      std::size_t rows;
+      std::vector<Column> columns;
+    };
+
+    explicit MRTable(std::size_t rows)
+      : data_(std::make_shared<Data>()) {
+      data_->rows = rows;
+    }
+
+    MRTable &column(const std::string &name, const int *data) {
+      return add(name, COLUMN_INT, data);
+    }
+
+    MRTable &column(const std::string &name, const double *data) {
+      return add(name, COLUMN_DOUBLE, data);
+    }
+
+    MRTable &column(const std::string &name, const std::string *data) {
+      return add(name, COLUMN_STRING, data);
+    }
+
+    MRTable &column(const std::string &name, const MRStringRef *data) {
+      return add(name, COLUMN_STRING_REF, data);
+    }
+
+    template<typename T>
+    MRTable &column(const std::string &name, const std::vector<T> &v) {
+      if (v.size() < rows()) {
+        throw MRError("ArgumentError", "column " + name + " is shorter than the table");
+      }
+      return column(name, v.data());
+    }
+
+    std::size_t rows() const {
+      return data_->rows;
+    }
+
+    const std::shared_ptr<const Data> data() const {
+      return data_;
+    }
+
+  private:
+    MRTable &add(const std::string &name, ColumnType type, const void *data) {
+      data_->columns.push_back(Column({ name, type, data }));
+      return *this;
+    }
+
+    std::shared_ptr<Data> data_;
+};
+
+/*!
+ * Ruby側のMRTableクラス. mrb_stateごとに初回使用時に定義される.
+ */
+struct MRTableClass {
+  static const char *name() {
+    return "MRTable";
+  }
+
+  // 表と, 絞り込んだ行の番号. rows が空ポインタの場合は全ての行
+  struct View {
+    std::shared_ptr<const MRTable::Data> table;
+    std::shared_ptr<const std::vector<std::uint32_t> > rows;
+
+    std::size_t size() const {
+      return rows ? rows->size() : table->rows;
+    }
+
+    template<typename F>
+    void each(F f) const {
+      if (rows) {
+        for (auto i : *rows) {
+          f(i);
+        }
+      } else {
+        for (std::uint32_t i = 0, n = static_cast<std::uint32_t>(table->rows); i < n; i++) {
+          f(i);
+        }
+      }
+    }
+  };
+
+  static const mrb_data_type *data_type();
+
+  static RClass *get(mrb_state *state);
+  static mrb_value wrap(mrb_state *state, View *view);
+
+  private:
+    static mrb_value size(mrb_state *state, mrb_value self);
+    static mrb_value columns(mrb_state *state, mrb_value self);
+    static mrb_value where(mrb_state *state, mrb_value self);
+    static mrb_value sum(mrb_state *state, mrb_value self);
+    static mrb_value group_by(mrb_state *state, mrb_value self);
+    static mrb_value map_column(mrb_state *state, mrb_value self);
+    static mrb_value row(mrb_state *state, mrb_value self);
+    static mrb_value to_a(mrb_state *state, mrb_value self);
+    static mrb_value each(mrb_state *state, mrb_value self);
+
+    static const View &view(mrb_state *state, mrb_value self) {
+      return *static_cast<const View *>(mrb_data_get_ptr(state, self, data_type()));
+    }
+
+    static const MRTable::Column &column(mrb_state *state, const View &v, mrb_sym name);
+    static mrb_value make_row(mrb_state *state, const View &v, std::uint32_t i);
+
+    template<typename Op>
+    static void visit(const MRTable::Column &c, Op &op);
+
+    struct WhereOp;
+    struct SumOp;
+    struct GroupByOp;
+    struct MapOp;
+
+    static void free_view(mrb_state *, void *ptr) {
+      delete static_cast<View *>(ptr);
+    }
+};
+
+/*!
+ * 列の要素の型ごとの変換. key_type は比較とグループ化に使う型.
+ * 整数の列は Ruby の値を切り詰めないよう mrb_int で比較する.
+ */
+template<typename E>
+struct MRColumnValue;
+
+template<>
+struct MRColumnValue<int> {
+  typedef mrb_int key_type;
+  typedef std::hash<mrb_int> hasher;
+  typedef mrb_int sum_type;
+
+  static key_type key(int v) {
+    return v;
+  }
+
+  static key_type from_mrb(mrb_value v) {
+    if (mrb_fixnum_p(v)) {
+      return mrb_fixnum(v);
+    }
+    throw MRError("TypeError", "expected Integer");
+  }
+
+  static mrb_value to_mrb(mrb_state *, key_type v) {
+    return mrb_fixnum_value(v);
+  }
+
+  static mrb_value sum_value(mrb_state *, sum_type v) {
+    return mrb_fixnum_value(v);
+  }
+};
+
+template<>
+struct MRColumnValue<double> {
+  typedef double key_type;
+  typedef std::hash<double> hasher;
+  typedef double sum_type;
+
+  static key_type key(double v) {
+    return v;
+  }
+
+  static key_type from_mrb(mrb_value v) {
+    if (mrb_float_p(v)) {
+      return mrb_float(v);
+    }
+    if (mrb_fixnum_p(v)) {
+      return static_cast<double>(mrb_fixnum(v));
+    }
+    throw MRError("TypeError", "expected Float");
+  }
+
+  static mrb_value to_mrb(mrb_state *state, key_type v) {
+    return mrb_float_value(state, v);
+  }
+
+  static mrb_value sum_value(mrb_state *state, sum_type v) {
+    return mrb_float_value(state, v);
+  }
+};
+
+template<>
+struct MRColumnValue<MRStringRef> {
+  typedef MRStringRef key_type;
+  typedef MRStringRef::Hash hasher;
+  typedef void sum_type;
+
+  static key_type key(const MRStringRef &v) {
+    return v;
+  }
+
+  static key_type from_mrb(mrb_value v) {
+    if (!mrb_string_p(v)) {
+      throw MRError("TypeError", "expected String");
+    }
+    return MRStringRef(RSTRING_PTR(v), RSTRING_LEN(v));
+  }
+
+  static mrb_value to_mrb(mrb_state *state, const key_type &v) {
+    return mrb_str_new(state, v.data, v.size);
+  }
+};
+
+template<>
+struct MRColumnValue<std::string> : MRColumnValue<MRStringRef> {
+  static key_type key(const std::string &v) {
+    return MRStringRef(v);
+  }
+};
+
+template<typename Op>
+void MRTableClass::visit(const MRTable::Column &c, Op &op) {
+  switch (c.type) {
+    case MRTable::COLUMN_INT:
+      op(static_cast<const int *>(c.data));
+      break;
+    case MRTable::COLUMN_DOUBLE:
+      op(static_cast<const double *>(c.data));
+      break;
+    case MRTable::COLUMN_STRING:
+      op(static_cast<const std::string *>(c.data));
+      break;
+    case MRTable::COLUMN_STRING_REF:
+      op(static_cast<const MRStringRef *>(c.data));
+      break;
+  }
+}
+
+struct MRTableClass::WhereOp {
+  mrb_state *state;
+  const View &v;
+  mrb_sym op;
+  mrb_value value;
+  std::vector<std::uint32_t> &out;
+
+  template<typename E>
+  void operator()(const E *data) {
+    apply(data, MRColumnValue<E>::from_mrb(value));
+  }
+
+  // 整数の列と Float の比較は double で行う
+  void operator()(const int *data) {
+    if (mrb_float_p(value)) {
+      apply(data, static_cast<double>(mrb_float(value)));
+    } else {
+      apply(data, MRColumnValue<int>::from_mrb(value));
+    }
+  }
+
+  template<typename E, typename K>
+  void apply(const E *data, const K &key) {
+    if (op == mrb_intern_lit(state, "==")) {
+      filter(data, key, std::equal_to<K>());
+    } else if (op == mrb_intern_lit(state, "!=")) {
+      filter(data, key, std::not_equal_to<K>());
+    } else if (op == mrb_intern_lit(state, "<")) {
+      filter(data, key, std::less<K>());
+    } else if (op == mrb_intern_lit(state, "<=")) {
+      filter(data, key, std::less_equal<K>());
+    } else if (op == mrb_intern_lit(state, ">")) {
+      filter(data, key, std::greater<K>());
+    } else if (op == mrb_intern_lit(state, ">=")) {
+      filter(data, key, std::greater_equal<K>());
+    } else {
+      throw MRError("ArgumentError", "unknown operator");
+    }
+  }
+
+  template<typename E, typename K, typename Compare>
+  void filter(const E *data, const K &key, Compare compare) {
+    out.reserve(v.size());
+    v.each([&](std::uint32_t i) {
+          if (compare(MRColumnValue<E>::key(data[i]), key)) {
+            out.push_back(i);
+          }
+        });
+  }
+};
+
+struct MRTableClass::SumOp {
+  mrb_state *state;
+  const View &v;
+  mrb_value result;
+
+  template<typename E>
+  void operator()(const E *data) {
+    add(data, static_cast<typename MRColumnValue<E>::sum_type *>(nullptr));
+  }
+
+  template<typename E, typename S>
+  void add(const E *data, S *) {
+    S s = 0;
+    v.each([&](std::uint32_t i) {
+          s += data[i];
+        });
+    result = MRColumnValue<E>::sum_value(state, s);
+  }
+
+  template<typename E>
+  void add(const E *, void *) {
+    throw MRError("TypeError", "cannot sum a String column");
+  }
+};
+
+struct MRTableClass::GroupByOp {
+  mrb_state *state;
+  const View &v;
+  mrb_value result;
+
+  template<typename E>
+  void operator()(const E *data) {
+    typedef MRColumnValue<E> Value;
+    typedef typename Value::key_type K;
+
+    // 初出順にグループを並べる
+    std::unordered_map<K, std::size_t, typename Value::hasher> index;
+    std::vector<K> keys;
+    std::vector<std::shared_ptr<std::vector<std::uint32_t> > > groups;
+    v.each([&](std::uint32_t i) {
+          auto key = Value::key(data[i]);
+          auto it = index.find(key);
+          if (it == index.end()) {
+            it = index.emplace(key, groups.size()).first;
+            keys.push_back(key);
+            groups.push_back(std::make_shared<std::vector<std::uint32_t> >());
+          }
+          groups[it->second]->push_back(i);
+        });
+
+    result = mrb_hash_new_capa(state, static_cast<mrb_int>(groups.size()));
+    int ai = mrb_gc_arena_save(state);
+    for (std::size_t g = 0; g < groups.size(); g++) {
+      auto k = Value::to_mrb(state, keys[g]);
+      mrb_hash_set(state, result, k, wrap(state, new View({ v.table, groups[g] })));
+      mrb_gc_arena_restore(state, ai);
+    }
+  }
+};
+
+// ブロックの break でこのフレームが巻き戻されずに抜けることがあるため,
+// ループ中はデストラクタを持つオブジェクトを生成しない
+struct MRTableClass::MapOp {
+  mrb_state *state;
+  const View &v;
+  mrb_value block;
+  mrb_value result;
+
+  template<typename E>
+  void operator()(const E *data) {
+    result = mrb_ary_new_capa(state, static_cast<mrb_int>(v.size()));
+    int ai = mrb_gc_arena_save(state);
+    v.each([&](std::uint32_t i) {
+          auto x = MRColumnValue<E>::to_mrb(state, MRColumnValue<E>::key(data[i]));
+          mrb_ary_push(state, result, mrb_nil_p(block) ? x : mrb_yield(state, block, x));
+          mrb_gc_arena_restore(state, ai);
+        });
+  }
+};
+
+inline const mrb_data_type *MRTableClass::data_type() {
+  static const mrb_data_type type = { "MRTable", free_view };
+  return &type;
+}
+
+inline RClass *MRTableClass::get(mrb_state *state) {
+  if (mrb_class_defined(state, name())) {
+    return mrb_class_get(state, name());
+  }
+  RClass *rclass = mrb_define_class(state, name(), state->object_class);
+  MRB_SET_INSTANCE_TT(rclass, MRB_TT_DATA);
+  mrb_include_module(state, rclass, mrb_module_get(state, "Enumerable"));
+  // ブロック付きの group_by は Enumerable の実装に渡す
+  mrb_define_alias(state, rclass, "__enumerable_group_by__", "group_by");
+  mrb_define_method(state, rclass, "size", size, ARGS_NONE());
+  mrb_define_method(state, rclass, "columns", columns, ARGS_NONE());
+  mrb_define_method(state, rclass, "where", where, ARGS_REQ(2) | ARGS_OPT(1));
+  mrb_define_method(state, rclass, "sum", sum, ARGS_REQ(1));
+  mrb_define_method(state, rclass, "group_by", group_by, ARGS_OPT(1));
+  mrb_define_method(state, rclass, "map_column", map_column, ARGS_REQ(1));
+  mrb_define_method(state, rclass, "row", row, ARGS_REQ(1));
+  mrb_define_method(state, rclass, "to_a", to_a, ARGS_NONE());
+  mrb_define_method(state, rclass, "each", each, ARGS_NONE());
+  return rclass;
+}
+
+inline mrb_value MRTableClass::wrap(mrb_state *state, View *view) {
+  return mrb_obj_value(mrb_data_object_alloc(state, get(state), view, data_type()));
+}
+
+inline const MRTable::Column &MRTableClass::column(mrb_state *state, const View &v, mrb_sym name) {
+  mrb_int len;
+  auto str = mrb_sym2name_len(state, name, &len);
+  for (const auto &c : v.table->columns) {
+    if (c.name.size() == static_cast<std::size_t>(len) && std::memcmp(c.name.data(), str, len) == 0) {
+      return c;
+    }
+  }
+  throw MRError("ArgumentError", "unknown column " + std::string(str, len));
+}
+
+inline mrb_value MRTableClass::make_row(mrb_state *state, const View &v, std::uint32_t i) {
+  auto hash = mrb_hash_new_capa(state, static_cast<mrb_int>(v.table->columns.size()));
+  for (const auto &c : v.table->columns) {
+    mrb_value x = mrb_nil_value();
+    switch (c.type) {
+      case MRTable::COLUMN_INT:
+        x = mrb_fixnum_value(static_cast<const int *>(c.data)[i]);
+        break;
+      case MRTable::COLUMN_DOUBLE:
+        x = mrb_float_value(state, static_cast<const double *>(c.data)[i]);
+        break;
+      case MRTable::COLUMN_STRING: {
+        const auto &s = static_cast<const std::string *>(c.data)[i];
+        x = mrb_str_new(state, s.data(), s.size());
+        break;
+      }
+      case MRTable::COLUMN_STRING_REF: {
+        const auto &s = static_cast<const MRStringRef *>(c.data)[i];
+        x = mrb_str_new(state, s.data, s.size);
+        break;
+      }
+    }
+    mrb_hash_set(state, hash, mrb_symbol_value(mrb_intern(state, c.name.data(), c.name.size())), x);
+  }
+  return hash;
+}
+
+inline mrb_value MRTableClass::size(mrb_state *state, mrb_value self) {
+  return mrb_fixnum_value(static_cast<mrb_int>(view(state, self).size()));
+}
+
+inline mrb_value MRTableClass::columns(mrb_state *state, mrb_value self) {
+  const auto &v = view(state, self);
+  auto ary = mrb_ary_new_capa(state, static_cast<mrb_int>(v.table->columns.size()));
+  for (const auto &c : v.table->columns) {
+    mrb_ary_push(state, ary, mrb_symbol_value(mrb_intern(state, c.name.data(), c.name.size())));
+  }
+  return ary;
+}
+
+inline mrb_value MRTableClass::where(mrb_state *state, mrb_value self) {
+  mrb_sym name;
+  mrb_value a, b;
+  int argc = mrb_get_args(state, "no|o", &name, &a, &b);
+  return MRExceptions::guard(state, [&]() {
+        const auto &v = view(state, self);
+        auto rows = std::make_shared<std::vector<std::uint32_t> >();
+        auto op = argc == 2 ? mrb_intern_lit(state, "==") : mrb_symbol(a);
+        if (argc != 2 && !mrb_symbol_p(a)) {
+          throw MRError("TypeError", "operator must be a Symbol");
+        }
+        WhereOp where = { state, v, op, argc == 2 ? a : b, *rows };
+        visit(column(state, v, name), where);
+        return wrap(state, new View({ v.table, rows }));
+      });
+}
+
+inline mrb_value MRTableClass::sum(mrb_state *state, mrb_value self) {
+  mrb_sym name;
+  mrb_get_args(state, "n", &name);
+  return MRExceptions::guard(state, [&]() {
+        const auto &v = view(state, self);
+        SumOp op = { state, v, mrb_nil_value() };
+        visit(column(state, v, name), op);
+        return op.result;
+      });
+}
+
+inline mrb_value MRTableClass::group_by(mrb_state *state, mrb_value self) {
+  mrb_value *argv;
+  mrb_int argc;
+  mrb_value block;
+  mrb_get_args(state, "*&", &argv, &argc, &block);
+  if (!mrb_nil_p(block)) {
+    return mrb_funcall_with_block(state, self, mrb_intern_lit(state, "__enumerable_group_by__"), argc, argv, block);
+  }
+  return MRExceptions::guard(state, [&]() {
+        if (argc != 1) {
+          throw MRError("ArgumentError", "group_by takes a column name or a block");
+        }
+        if (!mrb_symbol_p(argv[0])) {
+          throw MRError("TypeError", "column name must be a Symbol");
+        }
+        auto name = mrb_symbol(argv[0]);
+        const auto &v = view(state, self);
+        GroupByOp op = { state, v, mrb_nil_value() };
+        visit(column(state, v, name), op);
+        return op.result;
+      });
+}
+
+inline mrb_value MRTableClass::map_column(mrb_state *state, mrb_value self) {
+  mrb_sym name;
+  mrb_value block;
+  mrb_get_args(state, "n&", &name, &block);
+  return MRExceptions::guard(state, [&]() {
+        const auto &v = view(state, self);
+        MapOp op = { state, v, block, mrb_nil_value() };
+        visit(column(state, v, name), op);
+        return op.result;
+      });
+}
+
+inline mrb_value MRTableClass::row(mrb_state *state, mrb_value self) {
+  mrb_int i;
+  mrb_get_args(state, "i", &i);
+  const auto &v = view(state, self);
+  if (i < 0 || static_cast<std::size_t>(i) >= v.size()) {
+    return mrb_nil_value();
+  }
+  return make_row(state, v, v.rows ? (*v.rows)[i] : static_cast<std::uint32_t>(i));
+}
+
+inline mrb_value MRTableClass::to_a(mrb_state *state, mrb_value self) {
+  const auto &v = view(state, self);
+  auto ary = mrb_ary_new_capa(state, static_cast<mrb_int>(v.size()));
+  int ai = mrb_gc_arena_save(state);
+  v.each([&](std::uint32_t i) {
+        mrb_ary_push(state, ary, make_row(state, v, i));
+        mrb_gc_arena_restore(state, ai);
+      });
+  return ary;
+}
+
+inline mrb_value MRTableClass::each(mrb_state *state, mrb_value self) {
+  mrb_value block;
+  mrb_get_args(state, "&", &block);
+  if (mrb_nil_p(block)) {
+    return mrb_funcall(state, self, "to_enum", 0);
+  }
+
+  const auto &v = view(state, self);
+  int ai = mrb_gc_arena_save(state);
+  v.each([&](std::uint32_t i) {
+        mrb_yield(state, block, make_row(state, v, i));
+        mrb_gc_arena_restore(state, ai);
+      });
+  return self;
+}
+
+template<>
+struct MRType<MRTable> {
+  // 戻り値専用
+  static mrb_value to_mrb_value(mrb_state *state, const MRTable &v) {
+    return MRTableClass::wrap(state, new MRTableClass::View({ v.data(), nullptr }));
+  }
+};
+}  // namespace mrbind
+#endif  // INCLUDE_MRBIND_MR_TABLE_HPP__
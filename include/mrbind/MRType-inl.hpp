@@ -1,27 +1,43 @@
 #ifndef INCLUDE_MRBIND_MR_TYPE_INL_HPP__
 #define INCLUDE_MRBIND_MR_TYPE_INL_HPP__
-namespace mrbind { template<typename T>
+namespace mrbind {
+// 引数の取り出し. 別のクラスのインスタンスは TypeError (nil は NULL)
+template<typename T>
+T *MRType<T *>::expand_argument(mrb_state *state, argument_type arg) {
+  T *p = MRClass<T>::get_ptr(state, arg);
+  if (p == NULL && !mrb_nil_p(arg)) {
+    throw MRError("TypeError", std::string("wrong argument type ") + mrb_obj_classname(state, arg));
+  }
+  return p;
+}
+
+template<typename T>
 T *MRType<T *>::to_c_value(mrb_state *state, mrb_value v) {
-  return static_cast<T *>(mrb_get_datatype(state, v, &MRClass<T>::data_type));
+  return MRClass<T>::get_ptr(state, v);
 }
 
 template<typename T>
 mrb_value MRType<T *>::to_mrb_value(mrb_state *state, T *v) {
-  auto obj = mrb_obj_alloc(state, MRB_TT_DATA, MRClass<T>::rclass);
-  DATA_PTR(obj) = v;
-  return obj;
+  // 所有権は移さない
+  return mrb_obj_value(mrb_data_object_alloc(state, MRClass<T>::get_class(state), const_cast<T *>(v),
+      &MRClass<T>::borrowed_data_type));
+}
+
+template<typename T>
+const T *MRType<const T *>::expand_argument(mrb_state *state, argument_type arg) {
+  return MRType<T *>::expand_argument(state, arg);
 }
 
 template<typename T>
 const T *MRType<const T *>::to_c_value(mrb_state *state, mrb_value v) {
-  return static_cast<const T *>(mrb_get_datatype(state, v, &MRClass<T>::data_type));
+  return MRClass<T>::get_ptr(state, v);
 }
 
 template<typename T>
 mrb_value MRType<const T *>::to_mrb_value(mrb_state *state, const T *v) {
-  auto obj = mrb_obj_alloc(state, MRB_TT_DATA, MRClass<T>::rclass);
-  DATA_PTR(obj) = v;
-  return obj;
+  // 所有権は移さない
+  return mrb_obj_value(mrb_data_object_alloc(state, MRClass<T>::get_class(state), const_cast<T *>(v),
+      &MRClass<T>::borrowed_data_type));
 }
 }  // namespace mrbind
 
@@ -14,7 +14,7 @@ template<>
 struct MRType<int> {
   typedef mrb_int argument_type;
 
-  static int expand_argument(argument_type arg) {
+  static int expand_argument(mrb_state *, argument_type arg) {
     return arg;
   }
 
@@ -31,11 +31,18 @@ struct MRType<int> {
   }
 };
 
+template<>
+struct MRType<void> {
+  // 戻り値専用
+  static void to_c_value(mrb_state *, mrb_value) {
+  }
+};
+
 template<>
 struct MRType<bool> {
   typedef int argument_type;
 
-  static bool expand_argument(argument_type arg) {
+  static bool expand_argument(mrb_state *, argument_type arg) {
     return static_cast<bool>(arg);
   }
 
@@ -56,7 +63,7 @@ template<>
 struct MRType<std::string> {
   typedef char *argument_type;
 
-  static std::string expand_argument(argument_type arg) {
+  static std::string expand_argument(mrb_state *, argument_type arg) {
     return arg;
   }
 
@@ -77,7 +84,7 @@ template<>
 struct MRType<const char *> {
   typedef char *argument_type;
 
-  static const char *expand_argument(argument_type arg) {
+  static const char *expand_argument(mrb_state *, argument_type arg) {
     return arg;
   }
 
@@ -98,7 +105,7 @@ template<>
 struct MRType<char *> {
   typedef char *argument_type;
 
-  static char *expand_argument(argument_type arg) {
+  static char *expand_argument(mrb_state *, argument_type arg) {
     return arg;
   }
 
@@ -119,7 +126,7 @@ template<>
 struct MRType<mrb_sym> {
   typedef mrb_sym argument_type;
 
-  static mrb_sym expand_argument(argument_type arg) {
+  static mrb_sym expand_argument(mrb_state *, argument_type arg) {
     return arg;
   }
 
@@ -140,7 +147,7 @@ template<>
 struct MRType<mrb_value> {
   typedef mrb_value argument_type;
 
-  static mrb_value expand_argument(argument_type arg) {
+  static mrb_value expand_argument(mrb_state *, argument_type arg) {
     return arg;
   }
 
@@ -161,9 +168,7 @@ template<typename T>
 struct MRType<T *> {
   typedef mrb_value argument_type;
 
-  static T *expand_argument(argument_type arg) {
-    return static_cast<T *>(DATA_PTR(arg));
-  }
+  static T *expand_argument(mrb_state *state, argument_type arg);
 
   static T *to_c_value(mrb_state *state, mrb_value v);
 
@@ -178,9 +183,7 @@ template<typename T>
 struct MRType<const T *> {
   typedef mrb_value argument_type;
 
-  static const T *expand_argument(argument_type arg) {
-    return static_cast<const T *>(DATA_PTR(arg));
-  }
+  static const T *expand_argument(mrb_state *state, argument_type arg);
 
   static const T *to_c_value(mrb_state *state, mrb_value v);
 
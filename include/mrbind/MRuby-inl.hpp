@@ -4,6 +4,7 @@
 #include <mruby/compile.h>
 #include <mruby/data.h>
 
+#include <initializer_list>
 #include <string>
 #include <memory>
 
@@ -30,13 +31,29 @@ inline mrb_value MRuby::load_file(const std::string &filename) {
   return mrb_load_file_cxt(mrb_.get(), f.get(), cxt_.get());
 }
 
+inline mrb_value MRuby::load_stream(std::istream &in, const std::string &filename) {
+  return MRStreamLoader().load(mrb_.get(), in, filename);
+}
+
+inline mrb_value MRuby::load_mapped_file(const std::string &filename) {
+  return MRStreamLoader().load_mapped(mrb_.get(), filename);
+}
+
+inline mrb_value MRuby::watch_file(const std::string &filename) {
+  return MRStateData::get(mrb_.get())->slot<MRScriptSet>().watch(mrb_.get(), filename);
+}
+
+inline std::size_t MRuby::reload() {
+  return MRStateData::get(mrb_.get())->slot<MRScriptSet>().reload(mrb_.get());
+}
+
 inline std::string MRuby::to_string(mrb_value str) {
   return mrb_str_to_cstr(mrb_.get(), str);
 }
 
 template<typename T>
 T *MRuby::get_data(mrb_value o) {
-  return static_cast<T *>(mrb_data_get_ptr(mrb_.get(), o, &MRClass<T>::data_type));
+  return MRClass<T>::get_ptr(mrb_.get(), o);
 }
 
 template<typename Signature>
@@ -65,13 +82,81 @@ MRClass<T> MRuby::install_class(const std::string &name, RClass *super) {
   return MRClass<T>::create(mrb_.get(), name, super);
 }
 
+template<typename T, std::size_t N>
+MRClass<T> MRuby::install_class(const char *name, const MRMethodEntry (&methods)[N], RClass *super) {
+  return MRClass<T>::install(mrb_.get(), name, methods, super);
+}
+
 template<typename T>
 mrb_value MRuby::new_instance(const MRClass<T> clazz, std::function<void(T *)> initialize) {
-  mrb_value result = load_string(MRClass<T>::class_name + ".new");
+  // initialize の例外は load_string() と同様に mrb_state::exc に設定する
+  auto state = mrb_.get();
+  state->exc = nullptr;
+  auto result = MRExceptions::protect(state, [&]() {
+        return mrb_obj_new(state, MRClass<T>::get_class(state), 0, nullptr);
+      });
+  if (state->exc) {
+    return mrb_nil_value();
+  }
   initialize(get_data<T>(result));
   return result;
 }
 
+template<typename Iterator>
+mrb_value MRuby::wrap_range(Iterator first, Iterator last) {
+  return MRType<MRRange<Iterator> >::to_mrb_value(mrb_.get(), make_range(first, last));
+}
+
+template<typename Container>
+mrb_value MRuby::wrap_range(const Container &c) {
+  return wrap_range(c.begin(), c.end());
+}
+
+inline mrb_value MRuby::wrap_table(const MRTable &table) {
+  return MRType<MRTable>::to_mrb_value(mrb_.get(), table);
+}
+
+template<typename F>
+mrb_value MRuby::make_proc(F f) {
+  return mrbind::make_proc(mrb_.get(), f);
+}
+
+template<typename E>
+void MRuby::map_exception(const std::string &class_name) {
+  MRExceptions::map<E>(mrb_.get(), class_name);
+}
+
+inline void MRuby::spawn(mrb_value proc, MRScheduler::Callback on_done) {
+  MRStateData::get(mrb_.get())->slot<MRScheduler>().spawn(mrb_.get(), proc, on_done);
+}
+
+inline void MRuby::spawn(const std::string &code, MRScheduler::Callback on_done) {
+  auto proc = load_string("Proc.new do\n" + code + "\nend\n");
+  if (!exists_error()) {
+    spawn(proc, on_done);
+  } else if (on_done) {
+    on_done(MRExpected<mrb_value>(MRError::take(mrb_.get())));
+  }
+}
+
+inline std::size_t MRuby::run_once() {
+  return MRStateData::get(mrb_.get())->slot<MRScheduler>().run_once(mrb_.get());
+}
+
+inline void MRuby::run() {
+  MRStateData::get(mrb_.get())->slot<MRScheduler>().run(mrb_.get());
+}
+
+template<typename T>
+mrb_value MRuby::wrap_many(const std::vector<T> &v) {
+  return MRClass<T>::wrap_many(mrb_.get(), v.begin(), v.end());
+}
+
+template<typename T, typename Init>
+mrb_value MRuby::construct_many(std::size_t n, Init initialize) {
+  return MRClass<T>::construct_many(mrb_.get(), n, initialize);
+}
+
 template<typename T>
 void MRuby::each_array(mrb_value ary, std::function<void(T)> f) {
   auto size = call<int>(ary, "size");
@@ -101,7 +186,7 @@ mrb_value MRuby::to_mrb_value(T v) {
 template<typename ... Ts>
 std::string MRuby::args_format_string() {
   std::string result;
-  for (auto ch : {MRType<Ts>::arg_char() ...}) {
+  for (const auto &ch : std::initializer_list<std::string>{MRType<Ts>::arg_char() ...}) {
     result += ch;
   }
   return result;
@@ -112,7 +197,46 @@ inline bool MRuby::is_nil(mrb_value v) {
 }
 
 inline mrb_sym MRuby::sym(const std::string &str) {
-  return to_c_value<mrb_sym>(load_string(str));
+  return mrb_intern(mrb_.get(), str.data(), str.size());
+}
+
+inline mrb_sym MRuby::sym(const MRSymbolName &name) {
+  return mrbind::sym(mrb_.get(), name);
+}
+
+inline std::string MRuby::sym_name(mrb_sym sym) {
+  mrb_int length;
+  auto name = mrb_sym2name_len(mrb_.get(), sym, &length);
+  return std::string(name, length);
+}
+
+inline void MRuby::snapshot() {
+  auto data = MRStateData::get(mrb_.get());
+  data->slot<MRBaseline>().capture(mrb_.get());
+  data->slot<MRScriptSet>().mark();
+}
+
+inline void MRuby::reset() {
+  // 未完了のタスクと記録後に監視を始めたファイルは引き継がない
+  auto data = MRStateData::get(mrb_.get());
+  data->slot<MRScheduler>().cancel_all(mrb_.get());
+  data->slot<MRScriptSet>().rollback(mrb_.get());
+  data->slot<MRBaseline>().restore(mrb_.get());
+
+  // トップレベルのローカル変数も引き継がない
+  cxt_.reset(mrbc_context_new(mrb_.get()));
+}
+
+inline void MRuby::dump(mrb_value v, std::string &buffer) {
+  MRStateData::get(mrb_.get())->slot<MRMarshal>().dump(mrb_.get(), v, buffer);
+}
+
+inline mrb_value MRuby::load_dump(const std::string &buffer) {
+  return MRStateData::get(mrb_.get())->slot<MRMarshal>().load(mrb_.get(), buffer);
+}
+
+inline mrb_value MRuby::copy_from(MRuby &src, mrb_value v) {
+  return MRStateData::get(mrb_.get())->slot<MRMarshal>().copy(src.mrb_.get(), v, mrb_.get());
 }
 
 inline bool MRuby::exists_error() {
@@ -5,8 +5,10 @@
 #include <mruby/compile.h>
 #include <mruby/data.h>
 
+#include <istream>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace mrbind {
 class MRuby {
@@ -24,9 +26,20 @@ class MRuby {
   public:
     MRuby();
 
+    mrb_state *state() const {
+      return mrb_.get();
+    }
+
     mrb_value load_string(const std::string &str);
     mrb_value load_file(const std::string &filename);
 
+    // 入力全体を保持しない逐次実行. MRStreamLoader を参照
+    mrb_value load_stream(std::istream &in, const std::string &filename = "-");
+    mrb_value load_mapped_file(const std::string &filename);
+
+    mrb_value watch_file(const std::string &filename);
+    std::size_t reload();
+
     std::string to_string(mrb_value str);
 
     template<typename T>
@@ -47,9 +60,40 @@ class MRuby {
     template<typename T>
     MRClass<T> install_class(const std::string &name, RClass *super = nullptr);
 
+    // バインド表によるクラスのインストール. MRClass<T>::install() を参照
+    template<typename T, std::size_t N>
+    MRClass<T> install_class(const char *name, const MRMethodEntry (&methods)[N], RClass *super = nullptr);
+
     template<typename T>
     mrb_value new_instance(const MRClass<T> clazz, std::function<void(T *)> initialize);
 
+    template<typename Iterator>
+    mrb_value wrap_range(Iterator first, Iterator last);
+
+    template<typename Container>
+    mrb_value wrap_range(const Container &c);
+
+    mrb_value wrap_table(const MRTable &table);
+
+    template<typename F>
+    mrb_value make_proc(F f);
+
+    // この mrb_state でのC++の例外 E の変換先. MRExceptions を参照
+    template<typename E>
+    void map_exception(const std::string &class_name);
+
+    void spawn(mrb_value proc, MRScheduler::Callback on_done = nullptr);
+    // 構文エラーは on_done に渡す. on_done が無い場合は mrb_state::exc に残す
+    void spawn(const std::string &code, MRScheduler::Callback on_done = nullptr);
+    std::size_t run_once();
+    void run();
+
+    template<typename T>
+    mrb_value wrap_many(const std::vector<T> &v);
+
+    template<typename T, typename Init>
+    mrb_value construct_many(std::size_t n, Init initialize);
+
     template<typename T = mrb_value>
     void each_array(mrb_value ary, std::function<void(T)> f);
 
@@ -65,9 +109,26 @@ class MRuby {
     template<typename ... Ts>
     static std::string args_format_string();
 
+    // mrb_state間の値の受け渡し. MRMarshal を参照
+    void dump(mrb_value v, std::string &buffer);
+    mrb_value load_dump(const std::string &buffer);
+    mrb_value copy_from(MRuby &src, mrb_value v);
+
+    // トップレベルの状態の記録と復元. MRBaseline を参照.
+    // reset() は MRScheduler の未完了のタスクを破棄し, snapshot() 後に watch_file() したファイルを監視対象から外す.
+    // クラスの定義, 例外の対応表, MRMarshal の登録は引き継ぐ
+    void snapshot();
+    void reset();
+
+    MRGC gc() {
+      return MRGC(mrb_.get());
+    }
+
     bool is_nil(mrb_value v);
 
     mrb_sym sym(const std::string &str);
+    mrb_sym sym(const MRSymbolName &name);
+    std::string sym_name(mrb_sym sym);
 
     bool exists_error();
     void print_error();
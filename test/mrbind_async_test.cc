@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "mrbind.hpp"
+
+namespace {
+// 要求を保留しておき, テストから完了させる疑似I/Oサービス
+class FakeCache {
+  std::map<std::string, std::promise<std::string> > requests_;
+  std::mutex mutex_;
+
+  public:
+    std::size_t pending() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return requests_.size();
+    }
+
+    void complete(const std::string &key, const std::string &value) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      requests_[key].set_value(value);
+      requests_.erase(key);
+    }
+
+    void fail(const std::string &key) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      requests_[key].set_exception(std::make_exception_ptr(std::runtime_error("connection lost")));
+      requests_.erase(key);
+    }
+
+    struct MrbMethod {
+      static mrbind::MRAsync<std::string> lookup(FakeCache *self, std::string key) {
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        return self->requests_[key].get_future();
+      }
+    };
+};
+
+class mrbind_async : public testing::Test {
+  protected:
+    mrbind::MRuby mruby;
+    FakeCache *cache;
+
+    void SetUp() {
+      auto cache_class = mruby.install_class<FakeCache>("FakeCache");
+      cache_class.define().initialize<>();
+      cache_class.define().method<mrbind::MRAsync<std::string>, std::string>()
+        .from<&FakeCache::MrbMethod::lookup>("lookup");
+      cache = mruby.get_data<FakeCache>(mruby.load_string("$cache = FakeCache.new"));
+    }
+};
+}  // anonymous namespace
+
+TEST_F(mrbind_async, resume_in_completion_order) {
+  std::vector<std::string> results;
+  auto collect = [&](const mrbind::MRExpected<mrb_value> &r) {
+        ASSERT_TRUE(r.has_value());
+        results.push_back(mruby.to_string(r.value()));
+      };
+
+  mruby.spawn("$cache.lookup('a') + '!'", collect);
+  mruby.spawn("$cache.lookup('b') + '?'", collect);
+
+  // 両方のスクリプトが中断して要求を出す
+  EXPECT_EQ(2u, mruby.run_once());
+  EXPECT_EQ(2u, cache->pending());
+  EXPECT_TRUE(results.empty());
+
+  cache->complete("b", "B");
+  EXPECT_EQ(1u, mruby.run_once());
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ("B?", results[0]);
+
+  cache->complete("a", "A");
+  EXPECT_EQ(0u, mruby.run_once());
+  ASSERT_EQ(2u, results.size());
+  EXPECT_EQ("A!", results[1]);
+}
+
+TEST_F(mrbind_async, failed_request) {
+  bool failed = false;
+  mruby.spawn("$cache.lookup('x')", [&](const mrbind::MRExpected<mrb_value> &r) {
+        failed = !r.has_value();
+        EXPECT_STREQ("connection lost", r.error().what());
+      });
+
+  mruby.run_once();
+  cache->fail("x");
+  mruby.run();
+  EXPECT_TRUE(failed);
+}
+
+TEST_F(mrbind_async, rescue_failed_request) {
+  // 失敗は中断した位置で変換済みの例外として発生する
+  mruby.load_string("class LostError < StandardError; end");
+  mruby.map_exception<std::runtime_error>("LostError");
+
+  std::string result;
+  mruby.spawn(
+    "begin\n"
+    "  $cache.lookup('x')\n"
+    "rescue LostError => e\n"
+    "  'rescued: ' + e.message\n"
+    "end\n", [&](const mrbind::MRExpected<mrb_value> &r) {
+        ASSERT_TRUE(r.has_value());
+        result = mruby.to_string(r.value());
+      });
+
+  mruby.run_once();
+  cache->fail("x");
+  mruby.run();
+  EXPECT_EQ("rescued: connection lost", result);
+}
+
+TEST_F(mrbind_async, syntax_error) {
+  bool failed = false;
+  mruby.spawn("1 +", [&](const mrbind::MRExpected<mrb_value> &r) {
+        failed = !r.has_value();
+        EXPECT_EQ("SyntaxError", r.error().class_name());
+      });
+  EXPECT_TRUE(failed);
+  EXPECT_FALSE(mruby.exists_error());
+  EXPECT_EQ(0u, mruby.run_once());
+}
+
+TEST_F(mrbind_async, outside_fiber) {
+  // Fiberの外では完了まで待つ
+  auto t = std::async(std::launch::async, [&]() {
+        while (!cache->pending()) {
+          std::this_thread::yield();
+        }
+        cache->complete("k", "V");
+      });
+  EXPECT_EQ("V", mruby.to_string(mruby.load_string("$cache.lookup('k')")));
+  t.wait();
+}
@@ -0,0 +1,4 @@
+#include "mrbind_extern.hpp"
+
+MRBIND_INSTANTIATE_CLASS(Tally)
+MRBIND_INSTANTIATE_FUNCTION(int(int, int))
@@ -0,0 +1,22 @@
+#ifndef TEST_MRBIND_EXTERN_HPP__
+#define TEST_MRBIND_EXTERN_HPP__
+#include "mrbind.hpp"
+
+// MRBIND_EXPLICIT_INSTANTIATION のビルドでは mrbind_extern.cc でのみ実体化する
+struct Tally {
+  int total;
+
+  explicit Tally(int start)
+    : total(start) {
+  }
+
+  struct MrbMethod {
+    static int add(Tally *self, int n) {
+      return self->total += n;
+    }
+  };
+};
+
+MRBIND_EXTERN_CLASS(Tally)
+MRBIND_EXTERN_FUNCTION(int(int, int))
+#endif  // TEST_MRBIND_EXTERN_HPP__
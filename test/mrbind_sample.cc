@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <fstream>
+#include <sstream>
+
 #include "mrbind.hpp"
 
 namespace {
@@ -43,15 +46,30 @@ class Person {
       static int age_difference(Person *self, const Person *other) {
         return self->age_difference(*other);
       }
+
+      static Person *elder(Person *self, Person *other) {
+        return self->age_ >= other->age_ ? self : other;
+      }
     };
 };
 
+struct Point {
+  int x;
+  int y;
+  std::string label;
+};
+
 class mrbind_sample : public testing::Test {
   protected:
     mrbind::MRuby mruby;
 };
 }  // anonymous namespace
 
+MRBIND_STRUCT(Point,
+    MRBIND_FIELD(Point, x),
+    MRBIND_FIELD(Point, y),
+    MRBIND_FIELD(Point, label))
+
 TEST_F(mrbind_sample, get_function) {
   mruby.load_string(
     "def mul(a, b)\n"
@@ -160,5 +178,771 @@ TEST_F(mrbind_sample, use_cpp_class) {
     "My name is bob and I am 35 years old."
     "My name is bob and I am 35 years old."
     "My name is bob and I am 35 years old.", greet3);
+
+  // C++ から返したポインタのメソッドを呼び, 引数として渡し直す
+  person_class.define().method<Person *, Person *>()
+    .from<&Person::MrbMethod::elder>("elder");
+  auto elder = mruby.load_string(
+    "$dave = Person.new('dave', 50)\n"
+    "$erin = Person.new('erin', 20)\n"
+    "$erin.elder($dave).greeting\n");
+  EXPECT_EQ("My name is dave and I am 50 years old.", mruby.to_string(elder));
+  auto elder_diff = mruby.load_string("$erin.elder($dave).age_difference($dave.elder($erin))");
+  EXPECT_EQ(0, mrb_fixnum(elder_diff));
+
+  // initialize の例外はプロセスを終了させず mrb_state::exc に設定する
+  bool initialized = false;
+  auto broken = mruby.new_instance<Person>(person_class, [&](Person *) {
+        initialized = true;
+      });
+  EXPECT_TRUE(mruby.is_nil(broken));
+  EXPECT_TRUE(mruby.exists_error());
+  EXPECT_FALSE(initialized);
+  mruby.state()->exc = nullptr;
+}
+
+
+namespace {
+// 参照された回数を数えるイテレータ
+struct CountingIterator {
+  typedef std::input_iterator_tag iterator_category;
+  typedef int value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef const int *pointer;
+  typedef int reference;
+
+  const int *p;
+  int *count;
+
+  int operator*() const {
+    ++*count;
+    return *p;
+  }
+
+  CountingIterator &operator++() {
+    ++p;
+    return *this;
+  }
+
+  bool operator!=(const CountingIterator &other) const {
+    return p != other.p;
+  }
+};
+}  // anonymous namespace
+
+TEST_F(mrbind_sample, wrap_range) {
+  std::vector<int> v = {10, 20, 30, 40, 50};
+  auto range = mruby.wrap_range(v);
+
+  mruby.load_string(
+    "def sum(r)\n"
+    "  r.inject(0) { |a, b| a + b }\n"
+    "end\n");
+  EXPECT_EQ(150, mruby.call<int>("sum", range));
+  EXPECT_EQ(1, mruby.call<int>(range, "count", 30));
+
+  // 途中で止めた場合は残りの要素を変換しない
+  int count = 0;
+  CountingIterator first = {v.data(), &count};
+  CountingIterator last = {v.data() + v.size(), &count};
+  auto lazy = mruby.wrap_range(first, last);
+
+  auto head = mruby.call(lazy, "first", 2);
+  EXPECT_EQ(2, mruby.call<int>(head, "size"));
+  EXPECT_EQ(20, mruby.call<int>(head, "[]", 1));
+  EXPECT_EQ(2, count);
+}
+
+namespace {
+class IntList {
+  std::vector<int> items_;
+
+  public:
+    explicit IntList(int n) {
+      for (int i = 1; i <= n; i++) {
+        items_.push_back(i);
+      }
+    }
+
+    struct MrbMethod {
+      static void each_item(IntList *self, mrbind::MRBlock<void(int)> block) {
+        for (auto item : self->items_) {
+          block(item);
+        }
+      }
+
+      static int count_if(IntList *self, mrbind::MRBlock<bool(int)> pred) {
+        int count = 0;
+        for (auto item : self->items_) {
+          if (pred(item)) {
+            count++;
+          }
+        }
+        return count;
+      }
+    };
+};
+}  // anonymous namespace
+
+TEST_F(mrbind_sample, method_with_block) {
+  auto list_class = mruby.install_class<IntList>("IntList");
+  list_class.define().initialize<int>();
+  list_class.define().method<void, mrbind::MRBlock<void(int)> >()
+    .from<&IntList::MrbMethod::each_item>("each_item");
+  list_class.define().method<int, mrbind::MRBlock<bool(int)> >()
+    .from<&IntList::MrbMethod::count_if>("count_if");
+
+  auto sum = mruby.load_string(
+    "sum = 0\n"
+    "IntList.new(4).each_item { |x| sum += x }\n"
+    "sum\n");
+  EXPECT_EQ(10, mrb_fixnum(sum));
+
+  auto evens = mruby.load_string(
+    "IntList.new(5).count_if { |x| x % 2 == 0 }\n");
+  EXPECT_EQ(2, mrb_fixnum(evens));
+
+  // ブロックを渡さない場合は LocalJumpError
+  auto no_block = mruby.load_string(
+    "begin\n"
+    "  IntList.new(3).each_item\n"
+    "rescue LocalJumpError => e\n"
+    "  e.message\n"
+    "end\n");
+  ASSERT_FALSE(mruby.exists_error());
+  EXPECT_EQ("no block given", mruby.to_string(no_block));
 }
 
+TEST_F(mrbind_sample, make_proc) {
+  mruby.load_string(
+    "def sort_with(ary, cmp)\n"
+    "  ary.sort { |a, b| cmp.call(a, b) }\n"
+    "end\n");
+  auto ary = mruby.load_string("[3, 1, 2]");
+
+  // キャプチャの無いラムダ
+  auto desc = mruby.make_proc([](int a, int b) { return b - a; });
+  auto sorted = mruby.call("sort_with", ary, desc);
+  EXPECT_EQ(3, mruby.call<int>(sorted, "[]", 0));
+  EXPECT_EQ(1, mruby.call<int>(sorted, "[]", 2));
+
+  // 状態を持つ呼び出し可能オブジェクト
+  int calls = 0;
+  std::function<int(int, int)> asc = [&calls](int a, int b) {
+        calls++;
+        return a - b;
+      };
+  sorted = mruby.call("sort_with", ary, mruby.make_proc(asc));
+  EXPECT_EQ(1, mruby.call<int>(sorted, "[]", 0));
+  EXPECT_LT(0, calls);
+
+  std::string joined;
+  auto append = mruby.make_proc([&joined](std::string s) { joined += s; });
+  mruby.call(append, "call", "ab");
+  mruby.call(append, "call", "c");
+  EXPECT_EQ("abc", joined);
+
+  // 引数の型と数はメソッドと同じく検査される
+  mruby.load_string(
+    "def call_rescued(pr, *args)\n"
+    "  pr.call(*args)\n"
+    "rescue => e\n"
+    "  e.class.to_s\n"
+    "end\n");
+  EXPECT_EQ("TypeError", mruby.call<std::string>("call_rescued", desc, "x", 1));
+  EXPECT_EQ("ArgumentError", mruby.call<std::string>("call_rescued", desc, 1));
+}
+
+TEST_F(mrbind_sample, hash_and_struct) {
+  mruby.load_string(
+    "def double_values(h)\n"
+    "  r = {}\n"
+    "  h.each { |k, v| r[k] = v * 2 }\n"
+    "  r\n"
+    "end\n"
+    "def move(p)\n"
+    "  { x: p[:x] + 1, y: p[:y] + 2, label: p[:label] + '!' }\n"
+    "end\n");
+
+  std::map<std::string, int> m = {{"a", 1}, {"b", 2}};
+  auto doubled = mruby.call<std::map<std::string, int> >("double_values", m);
+  ASSERT_EQ(2u, doubled.size());
+  EXPECT_EQ(2, doubled["a"]);
+  EXPECT_EQ(4, doubled["b"]);
+
+  std::unordered_map<int, std::string> u = {{1, "x"}};
+  auto hash = mruby.to_mrb_value(u);
+  EXPECT_EQ("x", mruby.call<std::string>(hash, "[]", 1));
+
+  Point p = {10, 20, "p"};
+  auto moved = mruby.call<Point>("move", p);
+  EXPECT_EQ(11, moved.x);
+  EXPECT_EQ(22, moved.y);
+  EXPECT_EQ("p!", moved.label);
+
+  // Hashに無いメンバは値初期化される
+  auto partial = mruby.to_c_value<Point>(mruby.load_string("{ label: 'q' }"));
+  EXPECT_EQ(0, partial.x);
+  EXPECT_EQ(0, partial.y);
+  EXPECT_EQ("q", partial.label);
+
+  // Hash以外は TypeError
+  EXPECT_THROW(mruby.to_c_value<Point>(mruby.load_string("nil")), mrbind::MRError);
+  EXPECT_THROW((mruby.to_c_value<std::map<std::string, int> >(mruby.load_string("[1, 2]"))), mrbind::MRError);
+}
+
+namespace {
+class Geometry {
+  public:
+    struct MrbMethod {
+      static int circle_area(Geometry *, int r) {
+        return 3 * r * r;
+      }
+
+      static int rect_area(Geometry *, int w, int h) {
+        return w * h;
+      }
+
+      static std::string describe_int(Geometry *, int n) {
+        return "int";
+      }
+
+      static std::string describe_string(Geometry *, std::string s) {
+        return "string";
+      }
+    };
+};
+}  // anonymous namespace
+
+TEST_F(mrbind_sample, overloaded_method) {
+  auto geometry_class = mruby.install_class<Geometry>("Geometry");
+  geometry_class.define().initialize<>();
+  geometry_class.define().method<int, int>()
+    .from<&Geometry::MrbMethod::circle_area>("area");
+  geometry_class.define().method<int, int, int>()
+    .from<&Geometry::MrbMethod::rect_area>("area");
+  geometry_class.define().method<std::string, int>()
+    .from<&Geometry::MrbMethod::describe_int>("describe");
+  geometry_class.define().method<std::string, std::string>()
+    .from<&Geometry::MrbMethod::describe_string>("describe");
+
+  // 引数の数で選択
+  EXPECT_EQ(12, mrb_fixnum(mruby.load_string("Geometry.new.area(2)")));
+  EXPECT_EQ(20, mrb_fixnum(mruby.load_string("Geometry.new.area(4, 5)")));
+
+  // 引数の型で選択
+  EXPECT_EQ("int", mruby.to_string(mruby.load_string("Geometry.new.describe(1)")));
+  EXPECT_EQ("string", mruby.to_string(mruby.load_string("Geometry.new.describe('a')")));
+
+  // 合致する定義が無い
+  mruby.load_string("Geometry.new.area(1, 2, 3)");
+  EXPECT_TRUE(mruby.exists_error());
+}
+
+namespace {
+struct QuotaExceeded : std::runtime_error {
+  QuotaExceeded() : std::runtime_error("quota exceeded") {
+  }
+};
+
+class Store {
+  public:
+    struct MrbMethod {
+      static int at(Store *, int index) {
+        throw std::out_of_range("index out of range");
+      }
+
+      static int reserve(Store *, int size) {
+        if (size > 10) {
+          throw QuotaExceeded();
+        }
+        return size;
+      }
+    };
+};
+}  // anonymous namespace
+
+TEST_F(mrbind_sample, cpp_exception_to_ruby) {
+  mruby.load_string("class QuotaError < StandardError; end");
+  mruby.map_exception<QuotaExceeded>("QuotaError");
+
+  auto store_class = mruby.install_class<Store>("Store");
+  store_class.define().initialize<>();
+  store_class.define().method<int, int>().from<&Store::MrbMethod::at>("at");
+  store_class.define().method<int, int>().from<&Store::MrbMethod::reserve>("reserve");
+
+  auto rescued = mruby.load_string(
+    "begin\n"
+    "  Store.new.at(1)\n"
+    "rescue IndexError => e\n"
+    "  e.message\n"
+    "end\n");
+  ASSERT_FALSE(mruby.exists_error());
+  EXPECT_EQ("index out of range", mruby.to_string(rescued));
+
+  const char *quota_script =
+    "begin\n"
+    "  Store.new.reserve(100)\n"
+    "rescue StandardError => e\n"
+    "  e.class.to_s\n"
+    "end\n";
+  auto quota = mruby.load_string(quota_script);
+  EXPECT_EQ("QuotaError", mruby.to_string(quota));
+  EXPECT_EQ(5, mrb_fixnum(mruby.load_string("Store.new.reserve(5)")));
+
+  // 対応表は mrb_state ごとで, 再登録は置き換える
+  mruby.map_exception<QuotaExceeded>("QuotaError");
+  EXPECT_EQ("QuotaError", mruby.to_string(mruby.load_string(quota_script)));
+
+  mrbind::MRuby other;
+  other.load_string("class QuotaError < StandardError; end");
+  auto other_store = other.install_class<Store>("Store");
+  other_store.define().initialize<>();
+  other_store.define().method<int, int>().from<&Store::MrbMethod::reserve>("reserve");
+  EXPECT_EQ("RuntimeError", other.to_string(other.load_string(quota_script)));
+}
+
+TEST_F(mrbind_sample, ruby_exception_to_cpp) {
+  mruby.load_string(
+    "def check(n)\n"
+    "  raise ArgumentError, 'negative' if n < 0\n"
+    "  n\n"
+    "end\n");
+  auto check = mruby.get_function<int(int)>("check");
+
+  EXPECT_EQ(1, check.call_checked(1));
+  try {
+    check.call_checked(-1);
+    FAIL();
+  } catch (const mrbind::MRError &e) {
+    EXPECT_EQ("ArgumentError", e.class_name());
+    EXPECT_STREQ("negative", e.what());
+  }
+  EXPECT_FALSE(mruby.exists_error());
+
+  auto ok = check.try_call(2);
+  ASSERT_TRUE(ok.has_value());
+  EXPECT_EQ(2, ok.value());
+
+  auto ng = check.try_call(-2);
+  ASSERT_FALSE(ng.has_value());
+  EXPECT_EQ("ArgumentError", ng.error().class_name());
+  EXPECT_EQ(0, ng.value_or(0));
+
+  // 以前の呼び出しで残った例外は今回のエラーとして扱わない
+  mruby.load_string("raise 'stale'");
+  ASSERT_TRUE(mruby.exists_error());
+  EXPECT_EQ(3, check.call_checked(3));
+  mruby.load_string("raise 'stale'");
+  EXPECT_TRUE(check.try_call(4).has_value());
+}
+
+namespace {
+void write_file(const std::string &filename, const std::string &content) {
+  std::ofstream out(filename);
+  out << content;
+}
+}  // anonymous namespace
+
+TEST_F(mrbind_sample, reload) {
+  auto rule_a = testing::TempDir() + "mrbind_rule_a.rb";
+  auto rule_b = testing::TempDir() + "mrbind_rule_b.rb";
+  write_file(rule_a, "def rule_a; 1; end\n");
+  write_file(rule_b, "def rule_b; 2; end\n");
+
+  mruby.watch_file(rule_a);
+  mruby.watch_file(rule_b);
+  EXPECT_EQ(1, mruby.call<int>("rule_a"));
+  EXPECT_EQ(2, mruby.call<int>("rule_b"));
+
+  // 変更の無い場合は何もしない
+  EXPECT_EQ(0u, mruby.reload());
+
+  // 変更したファイルだけを再実行する
+  write_file(rule_a, "def rule_a; 10; end\n");
+  EXPECT_EQ(1u, mruby.reload());
+  EXPECT_EQ(10, mruby.call<int>("rule_a"));
+  EXPECT_EQ(2, mruby.call<int>("rule_b"));
+
+  // コンパイルエラーがあればどのファイルも反映しない
+  write_file(rule_a, "def rule_a; 100; end\n");
+  write_file(rule_b, "def rule_b(; end\n");
+  EXPECT_EQ(0u, mruby.reload());
+  EXPECT_TRUE(mruby.exists_error());
+  EXPECT_EQ(10, mruby.call<int>("rule_a"));
+
+  // 実行時の例外で止まったファイルと以降のファイルは次の reload() で再実行する
+  write_file(rule_a, "raise 'broken'\n");
+  write_file(rule_b, "def rule_b; 20; end\n");
+  mruby.state()->exc = nullptr;
+  EXPECT_EQ(0u, mruby.reload());
+  EXPECT_TRUE(mruby.exists_error());
+  EXPECT_EQ(2, mruby.call<int>("rule_b"));
+
+  write_file(rule_a, "def rule_a; 100; end\n");
+  mruby.state()->exc = nullptr;
+  EXPECT_EQ(2u, mruby.reload());
+  EXPECT_EQ(100, mruby.call<int>("rule_a"));
+  EXPECT_EQ(20, mruby.call<int>("rule_b"));
+
+  // 読み込めないファイルは監視対象に加えない
+  mruby.state()->exc = nullptr;
+  mruby.watch_file(testing::TempDir() + "mrbind_missing.rb");
+  EXPECT_TRUE(mruby.exists_error());
+  mruby.state()->exc = nullptr;
+  EXPECT_EQ(0u, mruby.reload());
+
+  // 最初の実行に失敗したファイルは反映済みとせず, 次の reload() で再実行する
+  auto rule_c = testing::TempDir() + "mrbind_rule_c.rb";
+  write_file(rule_c, "raise 'not yet'\n");
+  mruby.watch_file(rule_c);
+  EXPECT_TRUE(mruby.exists_error());
+  mruby.state()->exc = nullptr;
+  write_file(rule_c, "def rule_c; 3; end\n");
+  EXPECT_EQ(1u, mruby.reload());
+  EXPECT_EQ(3, mruby.call<int>("rule_c"));
+}
+
+namespace {
+struct Record {
+  int id;
+  int score;
+
+  Record()
+    : id(0), score(0) {
+  }
+
+  Record(int i, int s)
+    : id(i), score(s) {
+  }
+
+  struct MrbMethod {
+    static int id(Record *self) {
+      return self->id;
+    }
+
+    static int score(Record *self) {
+      return self->score;
+    }
+  };
+};
+}  // anonymous namespace
+
+TEST_F(mrbind_sample, wrap_many) {
+  auto record_class = mruby.install_class<Record>("Record");
+  record_class.define().method<int>().from<&Record::MrbMethod::id>("id");
+  record_class.define().method<int>().from<&Record::MrbMethod::score>("score");
+  mruby.load_string(
+    "def total(records)\n"
+    "  records.inject(0) { |sum, r| sum + r.score }\n"
+    "end\n");
+
+  std::vector<Record> records = {Record(1, 10), Record(2, 20), Record(3, 30)};
+  auto wrapped = mruby.wrap_many(records);
+  EXPECT_EQ(3, mruby.call<int>(wrapped, "size"));
+  EXPECT_EQ(60, mruby.call<int>("total", wrapped));
+
+  auto constructed = mruby.construct_many<Record>(1000, [](Record *r, std::size_t i) {
+        r->id = i;
+        r->score = 1;
+      });
+  EXPECT_EQ(1000, mruby.call<int>("total", constructed));
+  EXPECT_EQ(999, mruby.get_data<Record>(mruby.call(constructed, "last"))->id);
+}
+
+namespace {
+constexpr mrbind::MRMethodEntry person_methods[] = {
+  mrbind::MRClass<Person>::initializer<char *, int>(),
+  MRBIND_METHOD("greeting", Person::MrbMethod::greeting),
+  MRBIND_METHOD("greeting_n_times", Person::MrbMethod::greeting_n_times),
+  MRBIND_METHOD("age_difference", Person::MrbMethod::age_difference),
+};
+}  // anonymous namespace
+
+TEST_F(mrbind_sample, install_method_table) {
+  mruby.install_class<Person>("Person", person_methods);
+
+  // 別の mrb_state にも同じ表をインストールできる
+  mrbind::MRuby other;
+  other.install_class<Person>("Person", person_methods);
+  EXPECT_NE(mrbind::MRClass<Person>::get_class(mruby.state()),
+      mrbind::MRClass<Person>::get_class(other.state()));
+
+  EXPECT_EQ(
+    "My name is bob and I am 35 years old.",
+    mruby.to_string(mruby.load_string("Person.new('bob', 35).greeting")));
+  EXPECT_EQ(
+    "My name is carol and I am 72 years old.",
+    other.to_string(other.load_string("Person.new('carol', 72).greeting")));
+  auto diff = mruby.load_string("Person.new('carol', 72).age_difference(Person.new('bob', 35))");
+  EXPECT_EQ(37, mrb_fixnum(diff));
+
+  // Ruby 側の名前は mrb_state ごとに保持する
+  mrbind::MRuby renamed;
+  renamed.install_class<Person>("Human", person_methods);
+  EXPECT_EQ("Person", mrbind::MRClass<Person>::name(mruby.state()));
+  EXPECT_EQ("Human", mrbind::MRClass<Person>::name(renamed.state()));
+  EXPECT_EQ(35, mrb_fixnum(renamed.load_string("Human.new('bob', 35).age_difference(Human.new('x', 0))")));
+}
+
+TEST_F(mrbind_sample, transfer_values) {
+  mrbind::MRMarshal::copyable<Record>();
+  auto record_methods = [](mrbind::MRuby &m) {
+    auto record_class = m.install_class<Record>("Record");
+    record_class.define().method<int>().from<&Record::MrbMethod::score>("score");
+  };
+  record_methods(mruby);
+  mrbind::MRuby scoring;
+  record_methods(scoring);
+
+  auto parsed = mruby.load_string(
+    "shared = 'shared'\n"
+    "[{:id => 1, :name => shared, :tags => [:a, :b]}, {:id => 2, :name => shared, :ratio => 0.5}, nil, true]");
+  std::vector<Record> records = {Record(1, 10), Record(2, 20)};
+  auto wrapped = mruby.wrap_many(records);
+  scoring.load_string(
+    "def check(rows)\n"
+    "  [rows[0][:name].equal?(rows[1][:name]), rows[0][:tags], rows[1][:ratio], rows.size]\n"
+    "end\n"
+    "def total(records)\n"
+    "  records.inject(0) { |sum, r| sum + r.score }\n"
+    "end\n");
+
+  // バッファ経由
+  std::string buffer;
+  mruby.dump(parsed, buffer);
+  auto loaded = scoring.load_dump(buffer);
+  EXPECT_EQ("[true, [:a, :b], 0.5, 4]", scoring.to_string(scoring.call(scoring.call("check", loaded), "inspect")));
+
+  mruby.dump(wrapped, buffer);
+  EXPECT_EQ(30, scoring.call<int>("total", scoring.load_dump(buffer)));
+
+  // 直接コピー
+  auto copied = scoring.copy_from(mruby, parsed);
+  EXPECT_EQ("[true, [:a, :b], 0.5, 4]", scoring.to_string(scoring.call(scoring.call("check", copied), "inspect")));
+  EXPECT_EQ(30, scoring.call<int>("total", scoring.copy_from(mruby, wrapped)));
+
+  // 別の名前でのインストールは他の mrb_state 間の受け渡しに影響しない
+  mrbind::MRuby renamed;
+  renamed.install_class<Record>("ScoreRecord");
+  mruby.dump(wrapped, buffer);
+  EXPECT_EQ(30, scoring.call<int>("total", scoring.load_dump(buffer)));
+  auto first = renamed.call(renamed.copy_from(mruby, wrapped), "first");
+  EXPECT_EQ("ScoreRecord", renamed.call<std::string>(renamed.call(first, "class"), "to_s"));
+
+  // 登録されていない型は例外
+  EXPECT_THROW(mruby.dump(mruby.load_string("Object.new"), buffer), mrbind::MRError);
+}
+
+TEST_F(mrbind_sample, load_stream) {
+  std::stringstream script;
+  script << "$records = []\n";
+  for (int i = 0; i < 100; i++) {
+    script << "$records << {\n"
+           << "  :id => " << i << ",\n"
+           << "  :tags => [:a,\n"
+           << "    :b]\n"
+           << "}\n";
+  }
+  script << "total = 0\n"
+         << "$records.each { |r| total += r[:id] }\n"
+         << "total\n";
+  auto path = testing::TempDir() + "mrbind_stream.rb";
+  write_file(path, script.str());
+
+  // 文の途中で区切られるよう小さな単位で読み込む
+  std::istringstream in(script.str());
+  auto result = mrbind::MRStreamLoader(16).load(mruby.state(), in);
+  ASSERT_FALSE(mruby.exists_error());
+  EXPECT_EQ(4950, mrb_fixnum(result));
+
+  mrbind::MRuby mapped;
+  result = mapped.load_mapped_file(path);
+  ASSERT_FALSE(mapped.exists_error());
+  EXPECT_EQ(4950, mrb_fixnum(result));
+  EXPECT_EQ(100, mapped.call<int>(mapped.load_string("$records"), "size"));
+
+  // chunk_size 0 は1として扱う
+  mrbind::MRuby tiny;
+  result = mrbind::MRStreamLoader(0).load_mapped(tiny.state(), path);
+  ASSERT_FALSE(tiny.exists_error());
+  EXPECT_EQ(4950, mrb_fixnum(result));
+
+  // 構文エラー以降の文は実行しない
+  std::istringstream broken("$x = 1\n$x = (\n$x = 2\n)(\n$x = 3\n");
+  mrbind::MRStreamLoader(4).load(mruby.state(), broken);
+  EXPECT_TRUE(mruby.exists_error());
+
+  // max_statement を超える文は入力の残りを読み込まずに構文エラーとする
+  std::string large = "$y = 0\nbegin\n";
+  for (int i = 0; i < 20000; i++) {
+    large += "$y += 1\n";
+  }
+  large += "end\n";
+  mruby.state()->exc = nullptr;
+  std::istringstream capped(large);
+  mrbind::MRStreamLoader(16, 1024).load(mruby.state(), capped);
+  EXPECT_TRUE(mruby.exists_error());
+  EXPECT_GT(static_cast<std::streamoff>(large.size()), static_cast<std::streamoff>(capped.tellg()));
+
+  mruby.state()->exc = nullptr;
+  std::istringstream whole(large);
+  mrbind::MRStreamLoader(16).load(mruby.state(), whole);
+  ASSERT_FALSE(mruby.exists_error());
+  EXPECT_EQ(20000, mruby.call<int>(mruby.load_string("$y"), "to_i"));
+}
+
+TEST_F(mrbind_sample, pool) {
+  mrbind::MRPool pool(1, [](mrbind::MRuby &m) {
+        m.install_class<Person>("Person", person_methods);
+        m.load_string(
+          "$greeting = 'hello'\n"
+          "def helper; 1; end\n");
+      });
+  EXPECT_EQ(1u, pool.available());
+
+  auto tenant_rule = testing::TempDir() + "mrbind_tenant_rule.rb";
+  write_file(tenant_rule, "def tenant_rule; 1; end\n");
+  std::string cancelled;
+  {
+    auto mruby = pool.checkout();
+    EXPECT_EQ(0u, pool.available());
+    mruby->watch_file(tenant_rule);
+    mruby->spawn("Fiber.yield\n$late = 1\n", [&](const mrbind::MRExpected<mrb_value> &r) {
+          cancelled = r ? "done" : r.error().class_name();
+        });
+    mruby->load_string(
+      "$greeting = 'changed'\n"
+      "$tenant = 1\n"
+      "@secret = 2\n"
+      "local = 3\n"
+      "TENANT = 4\n"
+      "def helper; 100; end\n"
+      "def tenant_method; 5; end\n");
+    EXPECT_EQ(100, mruby->call<int>("helper"));
+  }
+  EXPECT_EQ(1u, pool.available());
+
+  // 返却時に初期化直後の状態に戻っている
+  auto mruby = pool.checkout();
+  auto data = mrbind::MRStateData::get(mruby->state());
+  EXPECT_EQ("RuntimeError", cancelled);
+  EXPECT_EQ(0u, data->slot<mrbind::MRScheduler>().size());
+  EXPECT_EQ(0u, data->slot<mrbind::MRScriptSet>().size());
+  EXPECT_TRUE(mruby->is_nil(mruby->load_string("$late")));
+  EXPECT_EQ("hello", mruby->to_string(mruby->load_string("$greeting")));
+  EXPECT_TRUE(mruby->is_nil(mruby->load_string("$tenant")));
+  EXPECT_TRUE(mruby->is_nil(mruby->load_string("@secret")));
+  EXPECT_EQ("nil", mruby->to_string(mruby->load_string("(defined?(local)).inspect")));
+  EXPECT_EQ("false", mruby->to_string(mruby->load_string("Object.const_defined?(:TENANT).inspect")));
+  EXPECT_EQ("false", mruby->to_string(mruby->load_string("respond_to?(:tenant_method).inspect")));
+  EXPECT_EQ(1, mruby->call<int>("helper"));
+  EXPECT_EQ(
+    "My name is bob and I am 35 years old.",
+    mruby->to_string(mruby->load_string("Person.new('bob', 35).greeting")));
+
+  // Lease はプールより後に破棄してよい
+  std::unique_ptr<mrbind::MRPool> temporary(new mrbind::MRPool(1));
+  auto lease = temporary->checkout();
+  temporary.reset();
+  EXPECT_EQ(3, mrb_fixnum(lease->load_string("1 + 2")));
+}
+
+TEST_F(mrbind_sample, table) {
+  std::vector<int> ids = {1, 2, 3, 4, 5};
+  std::vector<double> prices = {10.0, 20.5, 5.0, 7.5, 30.0};
+  std::vector<std::string> categories = {"book", "food", "book", "toy", "food"};
+  mrbind::MRTable table(ids.size());
+  table.column("id", ids).column("price", prices).column("category", categories);
+  mruby.load_string(
+    "def cheap_books(t)\n"
+    "  t.where(:category, 'book').where(:price, :<, 8).map_column(:id)\n"
+    "end\n"
+    "def totals(t)\n"
+    "  r = {}\n"
+    "  t.group_by(:category).each { |k, g| r[k] = g.sum(:price) }\n"
+    "  r\n"
+    "end\n"
+    "def scaled_ids(t)\n"
+    "  t.map_column(:id) { |v| v * 20 }\n"
+    "end\n"
+    "def ids_below_1_5(t)\n"
+    "  t.where(:id, :<, 1.5).map_column(:id)\n"
+    "end\n"
+    "def ids_below_3e9(t)\n"
+    "  t.where(:id, :<, 3_000_000_000).size\n"
+    "end\n"
+    "def rows_by_parity(t)\n"
+    "  t.group_by { |r| r[:id] % 2 }.map { |k, rs| [k, rs.size] }\n"
+    "end\n"
+    "def sum_error(t)\n"
+    "  t.sum(:category)\n"
+    "rescue TypeError\n"
+    "  :error\n"
+    "end\n");
+
+  auto t = mruby.wrap_table(table);
+  EXPECT_EQ(5, mruby.call<int>(t, "size"));
+  EXPECT_EQ("[3]", mruby.to_string(mruby.call(mruby.call("cheap_books", t), "inspect")));
+  EXPECT_EQ("{\"book\"=>15.0, \"food\"=>50.5, \"toy\"=>7.5}",
+      mruby.to_string(mruby.call(mruby.call("totals", t), "inspect")));
+  EXPECT_EQ("[20, 40, 60, 80, 100]", mruby.to_string(mruby.call(mruby.call("scaled_ids", t), "inspect")));
+  EXPECT_EQ("error", mruby.to_string(mruby.call(mruby.call("sum_error", t), "to_s")));
+
+  // 整数の列は Float と切り捨てずに比較する
+  EXPECT_EQ("[1]", mruby.to_string(mruby.call(mruby.call("ids_below_1_5", t), "inspect")));
+  EXPECT_EQ(5, mruby.call<int>("ids_below_3e9", t));
+
+  // ブロックを渡した group_by は Enumerable#group_by として行をまとめる
+  EXPECT_EQ("[[1, 3], [0, 2]]", mruby.to_string(mruby.call(mruby.call("rows_by_parity", t), "inspect")));
+
+  // 表より短い列は登録できない
+  std::vector<int> short_column = {1, 2};
+  EXPECT_THROW(table.column("short", short_column), mrbind::MRError);
+
+  // 行は要求された時だけ生成する
+  auto row = mruby.call(t, "row", 3);
+  EXPECT_EQ("{:id=>4, :price=>7.5, :category=>\"toy\"}", mruby.to_string(mruby.call(row, "inspect")));
+}
+
+TEST_F(mrbind_sample, bound_function) {
+  mruby.load_string(
+    "def add(a, b)\n"
+    "  a + b\n"
+    "end\n"
+    "def fail(x)\n"
+    "  raise ArgumentError, 'bad' if x < 0\n"
+    "  x\n"
+    "end\n"
+    "def deep(n)\n"
+    "  deep(n + 1)\n"
+    "end\n");
+
+  auto add = mruby.get_function<int(int, int)>("add").bind();
+  EXPECT_EQ(3, add(1, 2));
+  EXPECT_EQ(30, add(10, 20));
+
+  // 例外はMRErrorとして取り出せる
+  auto fail = mruby.get_function<int(int)>("fail").bind();
+  EXPECT_EQ(1, fail.call_checked(1));
+  EXPECT_THROW(fail.call_checked(-1), mrbind::MRError);
+  EXPECT_FALSE(mruby.exists_error());
+  EXPECT_EQ(2, fail.call_checked(2));
+
+  // 深い再帰で呼び出しフレームが再確保されても元の位置に戻る
+  auto deep = mruby.get_function<int(int)>("deep").bind();
+  try {
+    deep.call_checked(0);
+    FAIL();
+  } catch (const mrbind::MRError &e) {
+    EXPECT_EQ("SystemStackError", e.class_name());
+  }
+  EXPECT_EQ(3, fail.call_checked(3));
+  mruby.load_string("raise 'stale'");
+  EXPECT_EQ(4, fail.call_checked(4));
+
+  // 存在しないメソッド, cfunc, 引数の数の違いは bind() 時に検出する
+  EXPECT_THROW(mruby.get_function<int(int)>("no_such_method").bind(), mrbind::MRError);
+  EXPECT_THROW(mruby.get_function<int()>("object_id").bind(), mrbind::MRError);
+  EXPECT_THROW(mruby.get_function<int(int)>("add").bind(), mrbind::MRError);
+}
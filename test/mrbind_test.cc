@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include "mrbind.hpp"
+#include "mrbind_extern.hpp"
 
 namespace {
 class mrbind_test : public testing::Test {
@@ -14,3 +15,55 @@ TEST_F(mrbind_test, args_format_string) {
   EXPECT_EQ("iz", iz);
 }
 
+
+TEST_F(mrbind_test, sym) {
+  using namespace mrbind::literals;
+
+  static_assert("abc"_sym.hash() == mrbind::MRSymbolName::fnv1a("abc", 3),
+      "symbol hash must be computed at compile time");
+
+  auto abc = mruby.sym("abc");
+  EXPECT_EQ(abc, mruby.sym("abc"_sym));
+  EXPECT_EQ(abc, mruby.sym("abc"_sym));
+  EXPECT_EQ(abc, mruby.to_c_value<mrb_sym>(mruby.load_string(":abc")));
+  EXPECT_NE(abc, mruby.sym("abd"_sym));
+
+  // Rubyの式として解釈できない名前
+  EXPECT_EQ("foo bar", mruby.sym_name(mruby.sym("foo bar")));
+  EXPECT_EQ("foo bar", mruby.sym_name(mruby.sym("foo bar"_sym)));
+
+  EXPECT_TRUE(mruby.call<bool>(mruby.load_string(":size"), "==", "size"_sym));
+}
+
+TEST_F(mrbind_test, gc) {
+  mruby.gc().generational(true).interval_ratio(150).step_ratio(300);
+  EXPECT_TRUE(mruby.gc().is_generational());
+  mruby.gc().generational(false);
+  EXPECT_FALSE(mruby.gc().is_generational());
+
+  mruby.load_string("$keep = (1..1000).map { |i| i.to_s }");
+  mruby.gc().start().step();
+
+  auto stats = mruby.gc().stats();
+  EXPECT_EQ(2u, stats.collections);
+  EXPECT_LT(1000u, stats.live_objects);
+  EXPECT_LT(0u, stats.heap_pages);
+  EXPECT_LE(stats.last_pause, stats.max_pause);
+  EXPECT_LE(stats.max_pause, stats.total_pause);
+}
+
+TEST_F(mrbind_test, explicit_instantiation) {
+  // Tally と int(int, int) は mrbind_extern.cc の実体化を使う
+  auto tally_class = mruby.install_class<Tally>("Tally");
+  tally_class.define().initialize<int>();
+  tally_class.define().method<int, int>().from<&Tally::MrbMethod::add>("add");
+  mruby.load_string(
+    "def add_twice(a, b)\n"
+    "  t = Tally.new(a)\n"
+    "  t.add(b)\n"
+    "  t.add(b)\n"
+    "end\n");
+
+  auto add_twice = mruby.get_function<int(int, int)>("add_twice");
+  EXPECT_EQ(7, add_twice(1, 3));
+}